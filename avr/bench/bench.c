@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file bench.c
+ * @brief Benchmark firmware, run by the simavr harness (sim/ds3231_bench.c).
+ *
+ * Calls every public API once between BENCH_MARK writes, then sleeps with
+ * interrupts disabled, which ends the simulation.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "bench.h"
+#include "ds3231.h"
+#include "twi.h"
+
+#define BENCH(id, call) \
+	do \
+	{ \
+		BENCH_MARK = BENCH_##id; \
+		(void)(call); \
+		BENCH_MARK = BENCH_NONE; \
+	} while (0)
+
+int main(void)
+{
+	struct time time_ = { .sec = 30, .min = 45, .hour = 13, .mday = 5, .mon = 3, .year = 120, .wday = 5 };
+	struct time alarms[2];
+	uint8_t modes[2];
+	bool intrpts[2];
+	uint8_t mode;
+	bool intrpt;
+	bool active;
+	uint8_t hour, min, sec, mday, mon, year, day;
+	int8_t temp;
+	uint8_t frac;
+
+	TWI_master_initialize();
+	sei();                                       // The TWI0 backend transmits from its interrupt handler
+
+	BENCH(INIT, ds3231_init(DS3231_CTR_INTCN, 0));
+	BENCH(SET_TIME, ds3231_set_time(&time_));
+	BENCH(SET_TIME_S, ds3231_set_time_s(13, 45, 30));
+	BENCH(GET_TIME, ds3231_get_time(&time_));
+	BENCH(GET_FIELDS, ds3231_get_fields(&time_, DS3231_F_TIME));
+	BENCH(GET_TIME_S, ds3231_get_time_s(&hour, &min, &sec));
+	BENCH(GET_DATE_S, ds3231_get_date_s(&mday, &mon, &year, &hour, &min, &sec));
+	BENCH(GET_TEMP_INT, ds3231_get_temp_int(&temp, &frac));
+	BENCH(FORCE_TEMP_CONVERSION, ds3231_force_temp_conversion(0));
+	BENCH(SQW_ENABLE, ds3231_SQW_enable(false));
+	BENCH(OSC32KHZ_ENABLE, ds3231_osc32kHz_enable(false));
+	BENCH(SET_ALARM, ds3231_set_alarm(&time_, ALARM_1, ALARM_HOUR_M, true));
+	BENCH(SET_ALARM_S, ds3231_set_alarm_s(0, 14, 0, 0, ALARM_2, ALARM_HOUR_M, false));
+	BENCH(GET_ALARM, ds3231_get_alarm(&time_, ALARM_1, &mode, &intrpt));
+	BENCH(GET_ALARM_S, ds3231_get_alarm_s(&day, &hour, &min, &sec, ALARM_2, &mode, &intrpt));
+	BENCH(GET_ALARMS, ds3231_get_alarms(alarms, modes, intrpts));
+	BENCH(CHECK_ALARM, ds3231_check_alarm(&active, ALARM_1));
+	BENCH(CLEAR_ALARM, ds3231_clear_alarm(ALARM_1));
+	BENCH(RESET_ALARM, ds3231_reset_alarm(ALARM_2));
+	BENCH(SET_12H_MODE, ds3231_set_12h_mode(true));
+	ds3231_set_12h_mode(false);
+#ifdef DS3231_BATCH
+	BENCH_MARK = BENCH_BATCH_UPDATE;
+	ds3231_begin_update();
+	ds3231_set_time(&time_);
+	ds3231_set_alarm(&time_, ALARM_1, ALARM_MIN_M, true);
+	ds3231_SQW_enable(false);
+	ds3231_commit();
+	BENCH_MARK = BENCH_NONE;
+#endif
+
+	BENCH_MARK = BENCH_DONE;
+	cli();
+	sleep_enable();
+	sleep_cpu();                                 // Sleeping with interrupts disabled ends the simulation
+
+	for (;;);
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file bench.h
+ * @brief Benchmark markers shared by the firmware (bench.c) and the simavr harness.
+ *
+ * The firmware writes the id of an API to BENCH_MARK before calling it and 0 after
+ * it returns. The harness measures cycles, bus time and stack depth between the two
+ * writes, and stops at BENCH_DONE.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#define BENCH_DONE 0xFF                          //!< Marker written when all benchmarks have run.
+
+// Workload of the scheduler (sleep.c) and polling (poll.c) firmware
+#define SLEEP_INTERVAL 2                         //!< Task period in seconds.
+#define SLEEP_WAKEUPS  4                         //!< Number of measured task periods.
+
+#ifdef __AVR__
+	#define BENCH_MARK GPIOR0                    //!< Marker register, written with a single out instruction.
+#endif
+
+/**The benchmarked APIs, as X(id, name).
+ *
+ */
+#define BENCH_APIS(X) \
+	X(INIT,                  "ds3231_init") \
+	X(SET_TIME,              "ds3231_set_time") \
+	X(SET_TIME_S,            "ds3231_set_time_s") \
+	X(GET_TIME,              "ds3231_get_time") \
+	X(GET_FIELDS,            "ds3231_get_fields") \
+	X(GET_TIME_S,            "ds3231_get_time_s") \
+	X(GET_DATE_S,            "ds3231_get_date_s") \
+	X(GET_TEMP_INT,          "ds3231_get_temp_int") \
+	X(FORCE_TEMP_CONVERSION, "ds3231_force_temp_conversion") \
+	X(SQW_ENABLE,            "ds3231_SQW_enable") \
+	X(OSC32KHZ_ENABLE,       "ds3231_osc32kHz_enable") \
+	X(SET_ALARM,             "ds3231_set_alarm") \
+	X(SET_ALARM_S,           "ds3231_set_alarm_s") \
+	X(GET_ALARM,             "ds3231_get_alarm") \
+	X(GET_ALARM_S,           "ds3231_get_alarm_s") \
+	X(GET_ALARMS,            "ds3231_get_alarms") \
+	X(CHECK_ALARM,           "ds3231_check_alarm") \
+	X(CLEAR_ALARM,           "ds3231_clear_alarm") \
+	X(RESET_ALARM,           "ds3231_reset_alarm") \
+	X(SET_12H_MODE,          "ds3231_set_12h_mode") \
+	X(BATCH_UPDATE,          "ds3231_begin_update..ds3231_commit") \
+	X(SLEEP_RUN,             "ds3231_sleep_run") \
+	X(POLL_RUN,              "ds3231_check_alarm polling")
+
+#define BENCH_ID(id, name) BENCH_##id,
+
+enum bench_api {
+	BENCH_NONE,                                  //!< Marker written after an API returns.
+	BENCH_APIS(BENCH_ID)
+	BENCH_COUNT
+};
+
+#endif /* BENCH_H_ */
\ No newline at end of file
@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file bench_cpp.cpp
+ * @brief Benchmark firmware comparing the C++ driver (ds3231.hpp) with the C driver.
+ *
+ * Calls the APIs the C++ driver provides between BENCH_MARK writes. Built as is, it
+ * calls the C++ driver; built with BENCH_C_DRIVER, it makes the same calls through the
+ * C driver, so that the flash use and the cycles of both can be compared (see
+ * "make compare" in the Makefile).
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "bench.h"
+#include "ds3231.hpp"
+
+#define BENCH(id, call) \
+	do \
+	{ \
+		BENCH_MARK = BENCH_##id; \
+		(void)(call); \
+		BENCH_MARK = BENCH_NONE; \
+	} while (0)
+
+#ifdef BENCH_C_DRIVER
+	#define INIT()                ds3231_init(DS3231_CTR_INTCN, 0)
+	#define SET_TIME(t)           ds3231_set_time(t)
+	#define SET_TIME_S(h, m, s)   ds3231_set_time_s(h, m, s)
+	#define GET_TIME(t)           ds3231_get_time(t)
+	#define GET_TIME_S(h, m, s)   ds3231_get_time_s(h, m, s)
+	#define GET_TEMP_INT(i, f)    ds3231_get_temp_int(i, f)
+	#define SQW_ENABLE(e)         ds3231_SQW_enable(e)
+	#define OSC32KHZ_ENABLE(e)    ds3231_osc32kHz_enable(e)
+	#define SET_ALARM_S(d, h, m, s, a, mode, i) ds3231_set_alarm_s(d, h, m, s, a, mode, i)
+	#define CHECK_ALARM(act, a)   ds3231_check_alarm(act, a)
+	#define CLEAR_ALARM(a)        ds3231_clear_alarm(a)
+#else
+	typedef ds3231::DS3231<> RTC;
+
+	#define INIT()                RTC::init(DS3231_CTR_INTCN, 0)
+	#define SET_TIME(t)           RTC::set_time(t)
+	#define SET_TIME_S(h, m, s)   RTC::set_time_s(h, m, s)
+	#define GET_TIME(t)           RTC::get_time(t)
+	#define GET_TIME_S(h, m, s)   RTC::get_time_s(h, m, s)
+	#define GET_TEMP_INT(i, f)    RTC::get_temp_int(i, f)
+	#define SQW_ENABLE(e)         RTC::SQW_enable(e)
+	#define OSC32KHZ_ENABLE(e)    RTC::osc32kHz_enable(e)
+	#define SET_ALARM_S(d, h, m, s, a, mode, i) RTC::set_alarm<a, mode>(d, h, m, s, i)
+	#define CHECK_ALARM(act, a)   RTC::check_alarm<a>(act)
+	#define CLEAR_ALARM(a)        RTC::clear_alarm<a>()
+#endif
+
+int main(void)
+{
+	struct time time_ = { 30, 45, 13, 5, 3, 120, 5, false, 0 };
+	bool active;
+	uint8_t hour, min, sec;
+	int8_t temp;
+	uint8_t frac;
+
+	TWI_master_initialize();
+	sei();                                       // The TWI0 backend transmits from its interrupt handler
+
+	BENCH(INIT, INIT());
+	BENCH(SET_TIME, SET_TIME(&time_));
+	BENCH(SET_TIME_S, SET_TIME_S(13, 45, 30));
+	BENCH(GET_TIME, GET_TIME(&time_));
+	BENCH(GET_TIME_S, GET_TIME_S(&hour, &min, &sec));
+	BENCH(GET_TEMP_INT, GET_TEMP_INT(&temp, &frac));
+	BENCH(SQW_ENABLE, SQW_ENABLE(false));
+	BENCH(OSC32KHZ_ENABLE, OSC32KHZ_ENABLE(false));
+	BENCH(SET_ALARM_S, SET_ALARM_S(0, 14, 0, 0, ALARM_2, ALARM_HOUR_M, false));
+	BENCH(CHECK_ALARM, CHECK_ALARM(&active, ALARM_1));
+	BENCH(CLEAR_ALARM, CLEAR_ALARM(ALARM_1));
+
+	BENCH_MARK = BENCH_DONE;
+	cli();
+	sleep_enable();
+	sleep_cpu();                                 // Sleeping with interrupts disabled ends the simulation
+
+	for (;;);
+}
\ No newline at end of file
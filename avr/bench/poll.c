@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file poll.c
+ * @brief Polling benchmark firmware, run by the simavr harness (sim/ds3231_bench.c).
+ *
+ * Runs the task of sleep.c every SLEEP_INTERVAL seconds for SLEEP_WAKEUPS periods
+ * without sleeping: alarm 1 is armed for the end of the period and ds3231_check_alarm()
+ * is polled until it fires. Each period is marked, so that the harness reports the
+ * awake time of polling next to that of the power-down scheduler.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "bench.h"
+#include "ds3231.h"
+#include "twi.h"
+
+static volatile uint8_t runs;                    //!< Number of task runs.
+
+static void task(void)
+{
+	runs++;
+}
+
+int main(void)
+{
+	struct time time_;
+	bool active;
+	uint8_t i;
+
+	TWI_master_initialize();
+	sei();
+
+	ds3231_init(DS3231_CTR_INTCN, 0);
+
+	for (i = 0; i < SLEEP_WAKEUPS; i++)
+	{
+		BENCH_MARK = BENCH_POLL_RUN;
+		ds3231_get_time(&time_);
+		ds3231_set_alarm_s(0, 0, 0, (time_.sec + SLEEP_INTERVAL) % 60, ALARM_1, ALARM_SEC_M, false);
+		ds3231_clear_alarm(ALARM_1);
+		do
+		{
+			active = false;
+			ds3231_check_alarm(&active, ALARM_1);
+		} while (!active);
+		task();
+		BENCH_MARK = BENCH_NONE;
+	}
+
+	BENCH_MARK = BENCH_DONE;
+	cli();
+	sleep_enable();
+	sleep_cpu();                                 // Sleeping with interrupts disabled ends the simulation
+
+	for (;;);
+}
\ No newline at end of file
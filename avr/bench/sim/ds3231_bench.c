@@ -0,0 +1,436 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_bench.c
+ *
+ * Runs the benchmark firmware (bench.c) on simavr with a DS3231 on the USI bus and
+ * writes, as JSON, the CPU cycles, awake time, bus time, transmissions, bytes, stack
+ * depth and fastest SCL timing (highest clock rate, shortest low and high periods) of
+ * every API between its BENCH_MARK writes. Awake time excludes the cycles the MCU
+ * spent sleeping, which is what the power-down scheduler benchmark (sleep.c) measures.
+ * The awake time of the whole run, up to BENCH_DONE, is also reported per hour of
+ * simulated time, which compares the scheduler with polling (poll.c).
+ *
+ * simavr has no USI peripheral: its registers are emulated by usi_model.c, and the
+ * PIN register of the TWI port reads the modelled bus lines. The DS3231 model keeps
+ * time with a 1 Hz cycle timer and drives the INT/SQW pin of the MCU.
+ *
+ * Usage: ds3231_bench [-f Hz] -m mcu firmware.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+
+#include "bench.h"
+#include "ds3231_model.h"
+#include "usi_model.h"
+
+#define BENCH_TIMEOUT_S 60                       //!< Simulated seconds after which a run is aborted.
+
+/**I/O addresses (data space) and pins of the USI bus of a device.
+ *
+ */
+struct mcu {
+	const char* name;                            //!< simavr core name, as given to -mmcu.
+	uint16_t usicr;                              //!< USICR address.
+	uint16_t usisr;                              //!< USISR address.
+	uint16_t usidr;                              //!< USIDR address.
+	uint16_t pin;                                //!< PIN register of the TWI port.
+	uint16_t ddr;                                //!< DDR register of the TWI port.
+	uint16_t port;                               //!< PORT register of the TWI port.
+	uint8_t scl;                                 //!< SCL pin.
+	uint8_t sda;                                 //!< SDA pin.
+	uint16_t marker;                             //!< BENCH_MARK (GPIOR0) address.
+	char intPort;                                //!< Port of the pin wired to INT/SQW.
+	uint8_t intPin;                              //!< Pin wired to INT/SQW.
+};
+
+static const struct mcu mcus[] = {
+	{ "attiny85",   0x2D, 0x2E, 0x2F, 0x36, 0x37, 0x38, 2, 0, 0x31, 'B', 3 },   // INT/SQW on PB3 (PCINT3)
+	{ "atmega169p", 0xB8, 0xB9, 0xBA, 0x2C, 0x2D, 0x2E, 4, 5, 0x3E, 'D', 1 },   // INT/SQW on PD1 (INT0)
+};
+
+/**Measurements of one API.
+ *
+ */
+struct result {
+	unsigned runs;                               //!< Number of measured calls.
+	avr_cycle_count_t cycles;                    //!< CPU cycles.
+	avr_cycle_count_t awakeCycles;               //!< CPU cycles not spent sleeping.
+	avr_cycle_count_t busCycles;                 //!< Cycles between Start and Stop Conditions.
+	uint32_t transfers;                          //!< Start Conditions, including repeated ones.
+	uint32_t bytes;                              //!< Bytes addressed to the DS3231, including address bytes.
+	uint16_t stack;                              //!< Stack depth below the SP at the marker, in bytes.
+	avr_cycle_count_t sclLow;                    //!< Shortest SCL low period, 0 without bus traffic.
+	avr_cycle_count_t sclHigh;                   //!< Shortest SCL high period.
+	avr_cycle_count_t sclPeriod;                 //!< Shortest SCL period.
+};
+
+/**State of a benchmark run.
+ *
+ */
+struct bench {
+	avr_t* avr;
+	const struct mcu* mcu;
+	struct usi_model usi;
+	struct ds3231_model ds;
+	avr_irq_t* intIrq;                           //!< Pin wired to INT/SQW.
+	bool intLow;                                 //!< Level last driven on intIrq.
+	avr_io_read_t pinRead;                       //!< simavr handler of the PIN register.
+	void* pinParam;
+
+	uint8_t api;                                 //!< API being measured, BENCH_NONE between APIs.
+	bool done;                                   //!< BENCH_DONE was written.
+	avr_cycle_count_t start;                     //!< Cycle of the marker of the current API.
+	avr_cycle_count_t busStart;
+	avr_cycle_count_t sleepCycles;               //!< Cycles spent sleeping during the whole run.
+	avr_cycle_count_t sleepStart;
+	avr_cycle_count_t doneCycles;                //!< Cycles run until BENCH_DONE.
+	avr_cycle_count_t doneSleepCycles;           //!< Cycles spent sleeping until BENCH_DONE.
+	uint32_t startsStart;
+	uint32_t bytesStart;
+	uint16_t spStart;                            //!< SP at the marker of the current API.
+	uint16_t spMin;                              //!< Lowest SP since the marker.
+	uint16_t spLowest;                           //!< Lowest SP of the whole run.
+	struct result results[BENCH_COUNT];
+};
+
+#define BENCH_NAME(id, name) name,
+
+static const char* const names[BENCH_COUNT] = {
+	"",
+	BENCH_APIS(BENCH_NAME)
+};
+
+static uint16_t bench_sp(avr_t* avr)
+{
+	return (avr->data[R_SPL] | (avr->data[R_SPH] << 8));
+}
+
+/**Passes the master pins to the bus model and the INT/SQW level to the MCU.
+ *
+ */
+static void bench_sync(struct bench* b)
+{
+	uint8_t port = b->avr->data[b->mcu->port];
+	uint8_t ddr = b->avr->data[b->mcu->ddr];
+
+	b->usi.now = b->avr->cycle;
+	b->ds.now = b->avr->cycle * 1000000ULL / b->avr->frequency;
+	usi_set_pins(&b->usi, port & (1 << b->mcu->scl), port & (1 << b->mcu->sda),
+	             ddr & (1 << b->mcu->scl), ddr & (1 << b->mcu->sda));
+
+	if (b->ds.intLow != b->intLow)
+	{
+		b->intLow = b->ds.intLow;
+		avr_raise_irq(b->intIrq, !b->intLow);
+	}
+}
+
+static void usicr_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+	struct bench* b = param;
+
+	if (v & USI_TC)
+	{
+		avr->data[b->mcu->port] ^= 1 << b->mcu->scl;   // USITC toggles the SCL port bit
+	}
+	b->usi.now = avr->cycle;
+	usi_write_cr(&b->usi, v);
+	avr->data[addr] = b->usi.usicr;
+	bench_sync(b);
+}
+
+static void usisr_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+	struct bench* b = param;
+
+	usi_write_sr(&b->usi, v);
+	avr->data[addr] = usi_read_sr(&b->usi);
+}
+
+static void usidr_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+	struct bench* b = param;
+
+	b->usi.now = avr->cycle;
+	usi_write_dr(&b->usi, v);
+	avr->data[addr] = v;
+}
+
+static uint8_t usicr_read(avr_t* avr, avr_io_addr_t addr, void* param)
+{
+	return (((struct bench*)param)->usi.usicr);
+}
+
+static uint8_t usisr_read(avr_t* avr, avr_io_addr_t addr, void* param)
+{
+	return (usi_read_sr(&((struct bench*)param)->usi));
+}
+
+static uint8_t usidr_read(avr_t* avr, avr_io_addr_t addr, void* param)
+{
+	return (((struct bench*)param)->usi.usidr);
+}
+
+/**Reads the PIN register of the TWI port, with SCL and SDA taken from the bus lines.
+ *
+ */
+static uint8_t pin_read(avr_t* avr, avr_io_addr_t addr, void* param)
+{
+	struct bench* b = param;
+	uint8_t v = b->pinRead ? b->pinRead(avr, addr, b->pinParam) : avr->data[addr];
+
+	bench_sync(b);
+	v &= ~((1 << b->mcu->scl) | (1 << b->mcu->sda));
+	v |= (b->usi.scl << b->mcu->scl) | (b->usi.sda << b->mcu->sda);
+
+	return (v);
+}
+
+/**Starts or ends the measurement of an API.
+ *
+ */
+static void marker_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+	struct bench* b = param;
+	struct result* r;
+
+	avr->data[addr] = v;
+
+	if (v == BENCH_DONE)
+	{
+		b->done = true;
+		b->doneCycles = avr->cycle;
+		b->doneSleepCycles = b->sleepCycles;
+	}
+	else if (v != BENCH_NONE && v < BENCH_COUNT)
+	{
+		b->api = v;
+		b->start = avr->cycle;
+		b->busStart = b->usi.busCycles;
+		b->sleepStart = b->sleepCycles;
+		b->startsStart = b->usi.starts;
+		b->bytesStart = b->ds.bytes;
+		b->spStart = bench_sp(avr);
+		b->spMin = b->spStart;
+		b->usi.sclLow = 0;
+		b->usi.sclHigh = 0;
+		b->usi.sclPeriod = 0;
+	}
+	else if (v == BENCH_NONE && b->api != BENCH_NONE)
+	{
+		r = &b->results[b->api];
+		r->runs++;
+		r->cycles += avr->cycle - b->start;
+		r->awakeCycles += avr->cycle - b->start - (b->sleepCycles - b->sleepStart);
+		r->busCycles += b->usi.busCycles - b->busStart;
+		r->transfers += b->usi.starts - b->startsStart;
+		r->bytes += b->ds.bytes - b->bytesStart;
+		if (b->spStart - b->spMin > r->stack)
+		{
+			r->stack = b->spStart - b->spMin;
+		}
+		r->sclLow = b->usi.sclLow;
+		r->sclHigh = b->usi.sclHigh;
+		r->sclPeriod = b->usi.sclPeriod;
+		b->api = BENCH_NONE;
+	}
+}
+
+static avr_cycle_count_t ds3231_tick(avr_t* avr, avr_cycle_count_t when, void* param)
+{
+	struct bench* b = param;
+
+	b->ds.now = when * 1000000ULL / avr->frequency;
+	ds3231_model_tick(&b->ds);
+	bench_sync(b);
+
+	return (when + avr->frequency);
+}
+
+static double bench_us(const struct bench* b, avr_cycle_count_t cycles)
+{
+	return (cycles * 1e6 / b->avr->frequency);
+}
+
+static void bench_report(const struct bench* b)
+{
+	const struct result* r;
+	const char* sep = "";
+	unsigned i;
+
+	printf("{\n");
+	printf("  \"mcu\": \"%s\",\n", b->mcu->name);
+	printf("  \"f_cpu\": %u,\n", (unsigned)b->avr->frequency);
+	printf("  \"stack_max\": %u,\n", (unsigned)(b->avr->ramend - b->spLowest));
+	printf("  \"awake_us_per_hour\": %.0f,\n",
+	       (b->doneCycles - b->doneSleepCycles) * 3600e6 / b->doneCycles);
+	printf("  \"apis\": [");
+	for (i = BENCH_NONE + 1; i < BENCH_COUNT; i++)
+	{
+		r = &b->results[i];
+		if (!r->runs)
+		{
+			continue;                            // Not built into this firmware
+		}
+		printf("%s\n    {\"name\": \"%s\", \"cycles\": %llu, \"us\": %.2f, \"awake_us\": %.2f, "
+		       "\"bus_us\": %.2f, \"transactions\": %u, \"bytes\": %u, \"stack\": %u, "
+		       "\"scl_khz\": %.1f, \"scl_low_us\": %.3f, \"scl_high_us\": %.3f}",
+		       sep, names[i], (unsigned long long)(r->cycles / r->runs), bench_us(b, r->cycles / r->runs),
+		       bench_us(b, r->awakeCycles / r->runs), bench_us(b, r->busCycles / r->runs),
+		       r->transfers / r->runs, r->bytes / r->runs, r->stack,
+		       r->sclPeriod ? b->avr->frequency / 1e3 / r->sclPeriod : 0.0,
+		       bench_us(b, r->sclLow), bench_us(b, r->sclHigh));
+		sep = ",";
+	}
+	printf("\n  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+	static struct bench b;
+	elf_firmware_t firmware = { { 0 } };
+	const char* name = NULL;
+	unsigned long frequency = 8000000UL;
+	avr_io_addr_t pin;
+	avr_cycle_count_t timeout;
+	avr_cycle_count_t cycle;
+	bool sleeping;
+	uint16_t sp;
+	unsigned i;
+	int opt;
+	int state;
+
+	while ((opt = getopt(argc, argv, "f:m:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+				frequency = strtoul(optarg, NULL, 10);
+				break;
+			case 'm':
+				name = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-f Hz] -m mcu firmware.elf\n", argv[0]);
+				return (2);
+		}
+	}
+	if (optind != argc - 1 || !name || !frequency)
+	{
+		fprintf(stderr, "Usage: %s [-f Hz] -m mcu firmware.elf\n", argv[0]);
+		return (2);
+	}
+
+	for (i = 0; i < sizeof(mcus) / sizeof(mcus[0]) && strcmp(mcus[i].name, name); i++);
+	if (i == sizeof(mcus) / sizeof(mcus[0]))
+	{
+		fprintf(stderr, "%s: no USI pin map for this MCU\n", name);
+		return (2);
+	}
+	b.mcu = &mcus[i];
+
+	if (elf_read_firmware(argv[optind], &firmware))
+	{
+		fprintf(stderr, "%s: cannot read firmware\n", argv[optind]);
+		return (2);
+	}
+	b.avr = avr_make_mcu_by_name(name);
+	if (!b.avr)
+	{
+		fprintf(stderr, "%s: not supported by simavr\n", name);
+		return (2);
+	}
+	avr_init(b.avr);
+	avr_load_firmware(b.avr, &firmware);
+	b.avr->frequency = frequency;
+
+	ds3231_model_init(&b.ds);
+	usi_init(&b.usi, &b.ds);
+
+	avr_register_io_write(b.avr, b.mcu->usicr, usicr_write, &b);
+	avr_register_io_write(b.avr, b.mcu->usisr, usisr_write, &b);
+	avr_register_io_write(b.avr, b.mcu->usidr, usidr_write, &b);
+	avr_register_io_read(b.avr, b.mcu->usicr, usicr_read, &b);
+	avr_register_io_read(b.avr, b.mcu->usisr, usisr_read, &b);
+	avr_register_io_read(b.avr, b.mcu->usidr, usidr_read, &b);
+	avr_register_io_write(b.avr, b.mcu->marker, marker_write, &b);
+
+	// The ioport already handles the PIN register and avr_register_io_read() refuses to override it
+	pin = AVR_DATA_TO_IO(b.mcu->pin);
+	b.pinRead = b.avr->io[pin].r.c;
+	b.pinParam = b.avr->io[pin].r.param;
+	b.avr->io[pin].r.c = pin_read;
+	b.avr->io[pin].r.param = &b;
+
+	// INT/SQW is open drain, with a pull-up
+	b.intIrq = avr_io_getirq(b.avr, AVR_IOCTL_IOPORT_GETIRQ(b.mcu->intPort), b.mcu->intPin);
+	avr_raise_irq(b.intIrq, 1);
+
+	avr_cycle_timer_register(b.avr, frequency, ds3231_tick, &b);
+
+	b.spLowest = bench_sp(b.avr);
+	timeout = (avr_cycle_count_t)frequency * BENCH_TIMEOUT_S;
+	do
+	{
+		cycle = b.avr->cycle;
+		sleeping = b.avr->state == cpu_Sleeping;
+		state = avr_run(b.avr);
+		if (sleeping)
+		{
+			b.sleepCycles += b.avr->cycle - cycle;   // simavr skips to the next cycle timer while sleeping
+		}
+		bench_sync(&b);
+
+		sp = bench_sp(b.avr);
+		if (sp < b.spMin)
+		{
+			b.spMin = sp;
+		}
+		if (sp < b.spLowest)
+		{
+			b.spLowest = sp;
+		}
+	} while (state != cpu_Done && state != cpu_Crashed && b.avr->cycle < timeout);
+
+	if (!b.done)
+	{
+		fprintf(stderr, "%s: the firmware did not complete (%s)\n", argv[optind],
+		        (state == cpu_Crashed) ? "crashed" : "timeout");
+		return (1);
+	}
+
+	bench_report(&b);
+
+	return (0);
+}
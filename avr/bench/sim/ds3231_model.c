@@ -0,0 +1,417 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_model.c
+ *
+ */
+
+#include "ds3231_model.h"
+
+// Registers
+#define REG_SECONDS 0x00
+#define REG_MINUTES 0x01
+#define REG_HOURS   0x02
+#define REG_DAY     0x03
+#define REG_DATE    0x04
+#define REG_MONTH   0x05
+#define REG_YEAR    0x06
+#define REG_A1      0x07
+#define REG_A2      0x0B
+#define REG_CONTROL 0x0E
+#define REG_STATUS  0x0F
+#define REG_TEMP    0x11
+
+// Control and Status bits
+#define CTR_CONV    0x20
+#define CTR_INTCN   0x04
+#define CTR_A2IE    0x02
+#define CTR_A1IE    0x01
+#define STA_OSF     0x80
+#define STA_BSY     0x04
+#define STA_A2F     0x02
+#define STA_A1F     0x01
+#define STA_FLAGS   (STA_OSF | STA_A2F | STA_A1F)
+
+// Protocol states
+enum {
+	STATE_IDLE,                                  //!< Not addressed, waiting for a Start Condition.
+	STATE_ADDRESS,                               //!< Receiving the address byte.
+	STATE_ADDRESS_ACK,                           //!< Acknowledging the address.
+	STATE_WRITE,                                 //!< Receiving a data byte.
+	STATE_WRITE_ACK,                             //!< Acknowledging a data byte.
+	STATE_READ,                                  //!< Sending a data byte.
+	STATE_READ_ACK                               //!< Waiting for the master to acknowledge.
+};
+
+static uint8_t bcd_to_dec(uint8_t bcd)
+{
+	return ((bcd >> 4) * 10 + (bcd & 0x0F));
+}
+
+static uint8_t dec_to_bcd(uint8_t dec)
+{
+	return (((dec / 10) << 4) | (dec % 10));
+}
+
+/**Returns the hour 0..23 of an hours register in either mode.
+ *
+ */
+static uint8_t hour_decode(uint8_t reg)
+{
+	if (reg & 0x40)
+	{
+		return (bcd_to_dec(reg & 0x1F) % 12 + ((reg & 0x20) ? 12 : 0));
+	}
+	return (bcd_to_dec(reg & 0x3F));
+}
+
+/**Encodes the hour 0..23 in the mode of the hours register reg.
+ *
+ */
+static uint8_t hour_encode(uint8_t hour, uint8_t reg)
+{
+	if (reg & 0x40)
+	{
+		return (0x40 | ((hour >= 12) ? 0x20 : 0) | dec_to_bcd((hour % 12) ? hour % 12 : 12));
+	}
+	return (dec_to_bcd(hour));
+}
+
+static uint8_t days_in_month(uint8_t month, uint16_t year)
+{
+	static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if (month == 2 && !(year % 4) && ((year % 100) || !(year % 400)))
+	{
+		return (29);
+	}
+	return (days[month - 1]);
+}
+
+static void update_int(struct ds3231_model* ds)
+{
+	uint8_t control = ds->regs[REG_CONTROL];
+	uint8_t status = ds->regs[REG_STATUS];
+
+	ds->intLow = (control & CTR_INTCN) &&
+	             (((control & CTR_A1IE) && (status & STA_A1F)) || ((control & CTR_A2IE) && (status & STA_A2F)));
+}
+
+/**Completes a temperature conversion when its time has elapsed.
+ *
+ */
+static void update_conversion(struct ds3231_model* ds)
+{
+	if ((ds->regs[REG_STATUS] & STA_BSY) && ds->now >= ds->convEnd)
+	{
+		ds->regs[REG_STATUS] &= ~STA_BSY;
+		ds->regs[REG_CONTROL] &= ~CTR_CONV;
+	}
+}
+
+static void write_register(struct ds3231_model* ds, uint8_t reg, uint8_t value)
+{
+	switch (reg)
+	{
+	case REG_STATUS:
+		// Flags can only be cleared, BSY is read only
+		ds->regs[reg] = (ds->regs[reg] & value & STA_FLAGS) | (value & ~(STA_FLAGS | STA_BSY)) |
+		                (ds->regs[reg] & STA_BSY);
+		break;
+
+	case REG_CONTROL:
+		update_conversion(ds);
+		if ((value & CTR_CONV) && !(ds->regs[REG_STATUS] & STA_BSY))
+		{
+			ds->regs[REG_STATUS] |= STA_BSY;
+			ds->convEnd = ds->now + DS3231_MODEL_TCONV;
+		}
+		else if (!(ds->regs[REG_STATUS] & STA_BSY))
+		{
+			value &= ~CTR_CONV;
+		}
+		ds->regs[reg] = value | (ds->regs[reg] & CTR_CONV);
+		break;
+
+	case REG_TEMP:
+	case REG_TEMP + 1:
+		break;                                   // Read only
+
+	default:
+		ds->regs[reg] = value;
+		break;
+	}
+	update_int(ds);
+}
+
+static uint8_t read_register(struct ds3231_model* ds, uint8_t reg)
+{
+	update_conversion(ds);
+	return (ds->regs[reg]);
+}
+
+void ds3231_model_init(struct ds3231_model* ds)
+{
+	*ds = (struct ds3231_model){ 0 };
+	ds->regs[REG_DAY] = 0x07;                    // 2000-01-01 was a Saturday
+	ds->regs[REG_DATE] = 0x01;
+	ds->regs[REG_MONTH] = 0x81;                  // Century bit set for 2000
+	ds->regs[REG_CONTROL] = 0x1C;                // RS2, RS1, INTCN
+	ds->regs[REG_STATUS] = 0x88;                 // OSF, EN32kHz
+	ds->regs[REG_TEMP] = 0x19;                   // 25.25 °C
+	ds->regs[REG_TEMP + 1] = 0x40;
+}
+
+void ds3231_model_start(struct ds3231_model* ds)
+{
+	ds->state = STATE_ADDRESS;
+	ds->bit = 0;
+	ds->shift = 0;
+	ds->sdaLow = false;
+}
+
+void ds3231_model_stop(struct ds3231_model* ds)
+{
+	ds->state = STATE_IDLE;
+	ds->sdaLow = false;
+}
+
+void ds3231_model_scl_rise(struct ds3231_model* ds, bool sda)
+{
+	switch (ds->state)
+	{
+	case STATE_ADDRESS:
+	case STATE_WRITE:
+		ds->shift = (ds->shift << 1) | sda;
+		ds->bit++;
+		break;
+
+	case STATE_READ:
+		ds->bit++;
+		break;
+
+	case STATE_READ_ACK:
+		ds->ack = !sda;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**Loads the byte at the register pointer for reading and drives its first bit.
+ *
+ */
+static void load_byte(struct ds3231_model* ds)
+{
+	ds->shift = read_register(ds, ds->pointer);
+	ds->pointer = (ds->pointer + 1) % DS3231_MODEL_REGS;
+	ds->bit = 0;
+	ds->sdaLow = !(ds->shift & 0x80);
+	ds->state = STATE_READ;
+}
+
+void ds3231_model_scl_fall(struct ds3231_model* ds)
+{
+	switch (ds->state)
+	{
+	case STATE_ADDRESS:
+		if (ds->bit == 8)
+		{
+			if ((ds->shift >> 1) == DS3231_MODEL_ADDRESS)
+			{
+				ds->bytes++;
+				ds->sdaLow = true;               // ACK
+				ds->state = STATE_ADDRESS_ACK;
+			}
+			else
+			{
+				ds->state = STATE_IDLE;
+			}
+		}
+		break;
+
+	case STATE_ADDRESS_ACK:
+		if (ds->shift & 0x01)
+		{
+			load_byte(ds);
+		}
+		else
+		{
+			ds->sdaLow = false;
+			ds->pointerSet = false;
+			ds->bit = 0;
+			ds->shift = 0;
+			ds->state = STATE_WRITE;
+		}
+		break;
+
+	case STATE_WRITE:
+		if (ds->bit == 8)
+		{
+			ds->bytes++;
+			if (!ds->pointerSet)
+			{
+				ds->pointer = ds->shift % DS3231_MODEL_REGS;
+				ds->pointerSet = true;
+			}
+			else
+			{
+				write_register(ds, ds->pointer, ds->shift);
+				ds->pointer = (ds->pointer + 1) % DS3231_MODEL_REGS;
+			}
+			ds->sdaLow = true;                   // ACK
+			ds->state = STATE_WRITE_ACK;
+		}
+		break;
+
+	case STATE_WRITE_ACK:
+		ds->sdaLow = false;
+		ds->bit = 0;
+		ds->shift = 0;
+		ds->state = STATE_WRITE;
+		break;
+
+	case STATE_READ:
+		if (ds->bit == 8)
+		{
+			ds->bytes++;
+			ds->sdaLow = false;                  // Released for the master ACK
+			ds->state = STATE_READ_ACK;
+		}
+		else
+		{
+			ds->sdaLow = !(ds->shift & (0x80 >> ds->bit));
+		}
+		break;
+
+	case STATE_READ_ACK:
+		if (ds->ack)
+		{
+			load_byte(ds);
+		}
+		else
+		{
+			ds->state = STATE_IDLE;              // NACK, wait for the Stop Condition
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**Returns true if the alarm registers at reg match the current time.
+ *
+ * The mask bits (bit 7) are hierarchical, so every unmasked field has to match.
+ */
+static bool alarm_match(const struct ds3231_model* ds, uint8_t reg, bool seconds)
+{
+	const uint8_t* r = &ds->regs[REG_SECONDS];
+	const uint8_t* a = &ds->regs[reg];
+
+	if (seconds)
+	{
+		if (!(*a & 0x80) && (*a & 0x7F) != r[REG_SECONDS])
+		{
+			return (false);
+		}
+		a++;
+	}
+	else if (r[REG_SECONDS])
+	{
+		return (false);                          // Alarm 2 matches at 00 seconds
+	}
+
+	if (!(a[0] & 0x80) && (a[0] & 0x7F) != r[REG_MINUTES])
+	{
+		return (false);
+	}
+	if (!(a[1] & 0x80) && hour_decode(a[1]) != hour_decode(r[REG_HOURS]))
+	{
+		return (false);
+	}
+	if (!(a[2] & 0x80))
+	{
+		if (a[2] & 0x40)
+		{
+			return ((a[2] & 0x0F) == r[REG_DAY]);
+		}
+		return ((a[2] & 0x3F) == r[REG_DATE]);
+	}
+	return (true);
+}
+
+void ds3231_model_tick(struct ds3231_model* ds)
+{
+	uint8_t* r = ds->regs;
+	uint16_t year = 1900 + ((r[REG_MONTH] & 0x80) ? 100 : 0) + bcd_to_dec(r[REG_YEAR]);
+	uint8_t month = bcd_to_dec(r[REG_MONTH] & 0x1F);
+	uint8_t hour;
+
+	update_conversion(ds);
+
+	r[REG_SECONDS] = dec_to_bcd((bcd_to_dec(r[REG_SECONDS]) + 1) % 60);
+	if (!r[REG_SECONDS])
+	{
+		r[REG_MINUTES] = dec_to_bcd((bcd_to_dec(r[REG_MINUTES]) + 1) % 60);
+		if (!r[REG_MINUTES])
+		{
+			hour = (hour_decode(r[REG_HOURS]) + 1) % 24;
+			r[REG_HOURS] = hour_encode(hour, r[REG_HOURS]);
+			if (!hour)
+			{
+				r[REG_DAY] = r[REG_DAY] % 7 + 1;
+				if (bcd_to_dec(r[REG_DATE]) < days_in_month(month, year))
+				{
+					r[REG_DATE] = dec_to_bcd(bcd_to_dec(r[REG_DATE]) + 1);
+				}
+				else
+				{
+					r[REG_DATE] = 0x01;
+					if (month < 12)
+					{
+						r[REG_MONTH] = (r[REG_MONTH] & 0x80) | dec_to_bcd(month + 1);
+					}
+					else
+					{
+						year++;
+						r[REG_MONTH] = ((year >= 2000) ? 0x80 : 0) | 0x01;
+						r[REG_YEAR] = dec_to_bcd(year % 100);
+					}
+				}
+			}
+		}
+	}
+
+	if (alarm_match(ds, REG_A1, true))
+	{
+		r[REG_STATUS] |= STA_A1F;
+	}
+	if (alarm_match(ds, REG_A2, false))
+	{
+		r[REG_STATUS] |= STA_A2F;
+	}
+	update_int(ds);
+}
@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_model.h
+ * @brief Bit level model of a DS3231 I2C slave for the simavr benchmarks.
+ *
+ * Models the register file with the auto-incrementing register pointer, the 1 Hz
+ * time keeping, both alarms with the INT/SQW output, the flag semantics of the
+ * Status register and the temperature conversion started by CONV.
+ */
+
+#ifndef DS3231_MODEL_H_
+#define DS3231_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DS3231_MODEL_ADDRESS 0x68                //!< 7-bit slave address.
+#define DS3231_MODEL_REGS    0x13                //!< Number of registers.
+#define DS3231_MODEL_TCONV   125000UL            //!< Duration of a temperature conversion in us.
+
+/**State of the slave.
+ *
+ */
+struct ds3231_model {
+	uint8_t regs[DS3231_MODEL_REGS];             //!< Register file.
+	uint8_t pointer;                             //!< Register pointer.
+	uint8_t state;                               //!< Protocol state.
+	uint8_t bit;                                 //!< Bits received or sent of the current byte.
+	uint8_t shift;                               //!< Byte being received or sent.
+	bool pointerSet;                             //!< The first byte of a write has set the pointer.
+	bool ack;                                    //!< The master acknowledged the byte read.
+	bool sdaLow;                                 //!< The slave pulls SDA low.
+	bool intLow;                                 //!< The slave pulls INT/SQW low.
+	uint32_t bytes;                              //!< Bytes addressed to the slave, including the address.
+	uint64_t now;                                //!< Current time in us, kept up to date by the caller.
+	uint64_t convEnd;                            //!< End of the running temperature conversion in us.
+};
+
+/**Resets the slave to its power-on state at 2000-01-01 00:00:00, Saturday.
+ *
+ */
+void ds3231_model_init(struct ds3231_model* ds);
+
+void ds3231_model_start(struct ds3231_model* ds);
+void ds3231_model_stop(struct ds3231_model* ds);
+void ds3231_model_scl_rise(struct ds3231_model* ds, bool sda);
+void ds3231_model_scl_fall(struct ds3231_model* ds);
+
+/**Advances the time by one second and matches the alarms.
+ *
+ */
+void ds3231_model_tick(struct ds3231_model* ds);
+
+#endif /* DS3231_MODEL_H_ */
@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file usi_model.c
+ *
+ */
+
+#include "usi_model.h"
+
+void usi_init(struct usi_model* usi, struct ds3231_model* slave)
+{
+	*usi = (struct usi_model){ .usidr = 0xFF, .latch = true, .scl = true, .sda = true, .slave = slave };
+}
+
+/**Keeps the shortest of the SCL timings in *shortest.
+ *
+ */
+static void usi_shortest(uint64_t* shortest, uint64_t cycles)
+{
+	if (!*shortest || cycles < *shortest)
+	{
+		*shortest = cycles;
+	}
+}
+
+/**Records the SCL low, high and period times of a transmission.
+ *
+ */
+static void usi_scl_timing(struct usi_model* usi, bool scl)
+{
+	if (scl)
+	{
+		if (usi->busy && usi->sclFall > usi->busStart)
+		{
+			usi_shortest(&usi->sclLow, usi->now - usi->sclFall);
+		}
+		if (usi->busy && usi->sclRise > usi->busStart)
+		{
+			usi_shortest(&usi->sclPeriod, usi->now - usi->sclRise);
+		}
+		usi->sclRise = usi->now;
+	}
+	else
+	{
+		if (usi->busy && usi->sclRise > usi->busStart)
+		{
+			usi_shortest(&usi->sclHigh, usi->now - usi->sclRise);
+		}
+		usi->sclFall = usi->now;
+	}
+}
+
+/**Recomputes the bus lines until they are stable, feeding every edge to the USI and the slave.
+ *
+ */
+void usi_update(struct usi_model* usi)
+{
+	bool scl;
+	bool sda;
+
+	for (;;)
+	{
+		scl = !(usi->ddrScl && !usi->portScl);   // The DS3231 does not stretch the clock
+		if (!scl)
+		{
+			usi->latch = (usi->usidr & 0x80) != 0;   // Transparent while SCL is low
+		}
+		sda = !(usi->ddrSda && (!usi->portSda || !usi->latch)) && !usi->slave->sdaLow;
+
+		if (scl != usi->scl)
+		{
+			usi->scl = scl;
+			usi_scl_timing(usi, scl);
+			if (scl)
+			{
+				// The data register samples SDA on the positive edge
+				if (usi->usicr & USI_CS1)
+				{
+					usi->usidr = (usi->usidr << 1) | sda;
+				}
+				if (usi->busy)
+				{
+					usi->bits++;
+				}
+				ds3231_model_scl_rise(usi->slave, sda);
+			}
+			else
+			{
+				ds3231_model_scl_fall(usi->slave);
+			}
+			continue;                            // The slave may have changed SDA
+		}
+
+		if (sda != usi->sda)
+		{
+			usi->sda = sda;
+			if (scl && !sda)
+			{
+				// Start Condition
+				usi->usisr |= USI_SIF;
+				usi->starts++;
+				if (!usi->busy)
+				{
+					usi->busy = true;
+					usi->busStart = usi->now;
+				}
+				ds3231_model_start(usi->slave);
+			}
+			else if (scl && sda)
+			{
+				// Stop Condition
+				usi->usisr |= USI_PF;
+				if (usi->busy)
+				{
+					usi->busy = false;
+					usi->busCycles += usi->now - usi->busStart;
+				}
+				ds3231_model_stop(usi->slave);
+			}
+			continue;
+		}
+
+		return;
+	}
+}
+
+void usi_set_pins(struct usi_model* usi, bool portScl, bool portSda, bool ddrScl, bool ddrSda)
+{
+	if (portScl == usi->portScl && portSda == usi->portSda && ddrScl == usi->ddrScl && ddrSda == usi->ddrSda)
+	{
+		return;
+	}
+
+	usi->portScl = portScl;
+	usi->portSda = portSda;
+	usi->ddrScl = ddrScl;
+	usi->ddrSda = ddrSda;
+	usi_update(usi);
+}
+
+void usi_write_cr(struct usi_model* usi, uint8_t value)
+{
+	uint8_t count;
+
+	usi->usicr = value & ~USI_TC;                // USITC is a strobe and reads as zero
+
+	// Counter clocked by the USITC strobe (USICS1 and USICLK set)
+	if ((value & (USI_TC | USI_CLK | USI_CS1)) == (USI_TC | USI_CLK | USI_CS1))
+	{
+		count = ((usi->usisr & USI_CNT) + 1) & USI_CNT;
+		usi->usisr = (usi->usisr & ~USI_CNT) | count;
+		if (!count)
+		{
+			usi->usisr |= USI_OIF;
+		}
+	}
+}
+
+void usi_write_sr(struct usi_model* usi, uint8_t value)
+{
+	// Flags are cleared by writing one
+	usi->usisr = (usi->usisr & ~value & (USI_SIF | USI_OIF | USI_PF)) | (value & USI_CNT);
+}
+
+void usi_write_dr(struct usi_model* usi, uint8_t value)
+{
+	usi->usidr = value;
+	usi_update(usi);                             // The latch follows while SCL is low
+}
+
+uint8_t usi_read_sr(struct usi_model* usi)
+{
+	// USIDC compares the latch with the SDA line at any time
+	return (usi->usisr | ((usi->latch != usi->sda) ? USI_DC : 0));
+}
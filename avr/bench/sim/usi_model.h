@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file usi_model.h
+ * @brief USI two-wire mode and I2C bus model for the simavr benchmarks.
+ *
+ * simavr has no USI peripheral, so the benchmark emulates the parts of it used by
+ * twi.c: the 4-bit counter strobed by USITC, the data register shifted on the
+ * positive SCL edge, its output latch, and the Start/Stop detectors. The bus lines
+ * are the wired AND of the master pins and the DS3231 model. The SCL hold after a
+ * counter overflow (USIWM0) is not modelled, as twi.c drives SCL low itself.
+ */
+
+#ifndef USI_MODEL_H_
+#define USI_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ds3231_model.h"
+
+// USICR bits
+#define USI_TC    0x01                           //!< USITC: toggle the SCL port bit and strobe the counter.
+#define USI_CLK   0x02                           //!< USICLK: counter clocked by USITC (with USICS1 set).
+#define USI_CS1   0x08                           //!< USICS1: external clock for the data register.
+
+// USISR bits
+#define USI_SIF   0x80                           //!< Start Condition flag.
+#define USI_OIF   0x40                           //!< Counter overflow flag.
+#define USI_PF    0x20                           //!< Stop Condition flag.
+#define USI_DC    0x10                           //!< Data output collision.
+#define USI_CNT   0x0F                           //!< Counter value.
+
+/**USI module, bus lines and bus usage counters.
+ *
+ */
+struct usi_model {
+	uint8_t usicr;                               //!< USICR, without the strobe bits.
+	uint8_t usisr;                               //!< USISR flags and counter (USIDC is computed on read).
+	uint8_t usidr;                               //!< USIDR.
+	bool latch;                                  //!< Output latch, follows USIDR bit 7 while SCL is low.
+	bool portScl;                                //!< SCL port bit of the master.
+	bool portSda;                                //!< SDA port bit of the master.
+	bool ddrScl;                                 //!< SCL output enable of the master.
+	bool ddrSda;                                 //!< SDA output enable of the master.
+	bool scl;                                    //!< SCL line level.
+	bool sda;                                    //!< SDA line level.
+	struct ds3231_model* slave;                  //!< The only slave on the bus.
+
+	uint64_t now;                                //!< Current time in CPU cycles, kept up to date by the caller.
+	bool busy;                                   //!< Set between a Start and a Stop Condition.
+	uint64_t busStart;                           //!< Time of the Start Condition that made the bus busy.
+	uint64_t busCycles;                          //!< Cycles the bus was busy, up to the last Stop Condition.
+	uint32_t starts;                             //!< Start Conditions, including repeated ones.
+	uint32_t bits;                               //!< SCL clock pulses while the bus was busy.
+	uint64_t sclRise;                            //!< Time of the last positive SCL edge.
+	uint64_t sclFall;                            //!< Time of the last negative SCL edge.
+	uint64_t sclLow;                             //!< Shortest SCL low period while busy, 0 if none.
+	uint64_t sclHigh;                            //!< Shortest SCL high period while busy, 0 if none.
+	uint64_t sclPeriod;                          //!< Shortest SCL period while busy, 0 if none.
+};
+
+/**Resets the model to the released bus, with the master pins as inputs.
+ *
+ */
+void usi_init(struct usi_model* usi, struct ds3231_model* slave);
+
+/**Sets the master port and direction bits of SCL and SDA and updates the bus.
+ *
+ */
+void usi_set_pins(struct usi_model* usi, bool portScl, bool portSda, bool ddrScl, bool ddrSda);
+
+/**Writes USICR. With USITC set the caller must toggle the SCL port bit, then call usi_set_pins().
+ *
+ */
+void usi_write_cr(struct usi_model* usi, uint8_t value);
+void usi_write_sr(struct usi_model* usi, uint8_t value);
+void usi_write_dr(struct usi_model* usi, uint8_t value);
+uint8_t usi_read_sr(struct usi_model* usi);
+
+/**Propagates a change of the slave outputs to the bus lines.
+ *
+ */
+void usi_update(struct usi_model* usi);
+
+#endif /* USI_MODEL_H_ */
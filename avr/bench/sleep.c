@@ -0,0 +1,74 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file sleep.c
+ * @brief Scheduler benchmark firmware, run by the simavr harness (sim/ds3231_bench.c).
+ *
+ * Runs one task every SLEEP_INTERVAL seconds for SLEEP_WAKEUPS wake-ups, marking
+ * each ds3231_sleep_run() call, so that the harness reports the awake time per
+ * wake-up next to the time spent in power-down. poll.c runs the same task by polling.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "bench.h"
+#include "ds3231.h"
+#include "ds3231_sleep.h"
+#include "twi.h"
+
+static volatile uint8_t runs;                    //!< Number of task runs.
+
+static void task(void)
+{
+	runs++;
+}
+
+static struct ds3231_task tasks[] = { { task, SLEEP_INTERVAL } };
+
+int main(void)
+{
+	uint8_t i;
+
+	TWI_master_initialize();
+	sei();
+
+	ds3231_init(DS3231_CTR_INTCN, 0);
+	ds3231_sleep_init(tasks, 1);
+
+	for (i = 0; i < SLEEP_WAKEUPS; i++)
+	{
+		BENCH_MARK = BENCH_SLEEP_RUN;
+		ds3231_sleep_run();
+		BENCH_MARK = BENCH_NONE;
+	}
+
+	BENCH_MARK = BENCH_DONE;
+	cli();
+	sleep_enable();
+	sleep_cpu();                                 // Sleeping with interrupts disabled ends the simulation
+
+	for (;;);
+}
\ No newline at end of file
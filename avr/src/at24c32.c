@@ -0,0 +1,333 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file at24c32.c
+ *
+ */
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "at24c32.h"
+#include "calendar.h"
+#include "twi.h"
+
+#define WRITE_ADD (AT24C32_ADDRESS << 1)         //!< Address for writing to the AT24C32 (the address bits are replaced from at24c32_device).
+
+#define SEQ_ERASED   0xFFFF                      //!< Sequence number of an erased slot.
+#define SLOTS_PER_PAGE (AT24C32_PAGE_SIZE / AT24C32_RECORD_SIZE)
+
+struct TWI_device at24c32_device = { .address = AT24C32_ADDRESS };
+
+static uint8_t pageBuf[3 + AT24C32_PAGE_SIZE];   //!< Page buffer; a record at page offset n is stored from pageBuf[3 + n].
+static uint16_t nextSlot;                        //!< Slot of the next record.
+static uint16_t nextSeq;                         //!< Sequence number of the next record.
+static uint16_t records;                         //!< Number of records in the log, including buffered ones.
+static uint16_t firstPending;                    //!< Slot of the first buffered record.
+static uint8_t pending;                          //!< Number of buffered records.
+static bool writeCycle;                          //!< Set while the EEPROM may still be in a write cycle.
+
+/**Adds n to a sequence number, skipping SEQ_ERASED.
+ *
+ */
+static uint16_t seq_add(uint16_t seq, uint16_t n)
+{
+	return (((uint32_t)seq + n) % SEQ_ERASED);
+}
+
+/**Waits for the write cycle of the last page write to finish.
+ *
+ * The EEPROM does not acknowledge its address during a write cycle, so it is
+ * addressed until it does.
+ */
+static uint8_t at24c32_wait(void)
+{
+	uint8_t msgBuf[3];
+	uint8_t attempt;
+
+	if (!writeCycle)
+	{
+		return (AT24C32_OK);
+	}
+
+	for (attempt = 0; attempt < AT24C32_POLL_LIMIT; attempt++)
+	{
+		// A memory address without data does not start a write cycle
+		msgBuf[0] = WRITE_ADD;
+		msgBuf[1] = 0;
+		msgBuf[2] = 0;
+		if (TWI_device_transceive(&at24c32_device, msgBuf, 3))
+		{
+			writeCycle = false;
+			return (AT24C32_OK);
+		}
+		if (TWI_get_state_info() != TWI_NO_ACK_ON_ADDRESS)
+		{
+			// Handle transmission error
+			return (AT24C32_ERR_BUS);
+		}
+		_delay_us(AT24C32_POLL_DELAY_US);
+	}
+
+	return (AT24C32_ERR_TIMEOUT);
+}
+
+/**Reads bytes from the EEPROM.
+ *
+ * @param[in]     addr       EEPROM address of the first byte.
+ * @param[out]    msgBuf     Transmission buffer of at least count + 1 bytes. The bytes are stored from msgBuf[1].
+ * @param[in]     count      Number of bytes to read.
+ */
+static uint8_t at24c32_read_bytes(uint16_t addr, uint8_t* msgBuf, uint8_t count)
+{
+	uint8_t result;
+
+	result = at24c32_wait();
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	// Write the memory address, then read from it after a repeated Start Condition
+	msgBuf[0] = WRITE_ADD;
+	msgBuf[1] = addr >> 8;
+	msgBuf[2] = addr & 0xFF;
+	if (!TWI_device_write_read(&at24c32_device, msgBuf, 3, count))
+	{
+		// Handle transmission error
+		return (AT24C32_ERR_BUS);
+	}
+
+	return (AT24C32_OK);
+}
+
+/**Reads the sequence number of a slot.
+ *
+ */
+static uint8_t at24c32_read_seq(uint16_t slot, uint16_t* seq)
+{
+	uint8_t msgBuf[3];
+	uint8_t result;
+
+	result = at24c32_read_bytes(slot * AT24C32_RECORD_SIZE, msgBuf, 2);
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	*seq = msgBuf[1] | (msgBuf[2] << 8);
+
+	return (AT24C32_OK);
+}
+
+uint8_t at24c32_init(void)
+{
+	uint16_t first;
+	uint16_t seq;
+	uint16_t low = 0;
+	uint16_t high = AT24C32_RECORDS - 1;
+	uint8_t result;
+
+	pending = 0;
+	writeCycle = true;                           // A write may have been interrupted by a reset
+
+	result = at24c32_read_seq(0, &first);
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	if (first == SEQ_ERASED)
+	{
+		nextSlot = 0;
+		nextSeq = 0;
+		records = 0;
+		return (AT24C32_OK);
+	}
+
+	// Slots up to the newest record hold first, first + 1, ...; later slots hold
+	// records of the previous lap, or are erased
+	while (low < high)
+	{
+		uint16_t mid = (low + high + 1) / 2;
+
+		result = at24c32_read_seq(mid, &seq);
+		if (result != AT24C32_OK)
+		{
+			return (result);
+		}
+
+		if (seq == seq_add(first, mid))
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	nextSlot = (low + 1) % AT24C32_RECORDS;
+	nextSeq = seq_add(first, low + 1);
+	records = AT24C32_RECORDS;
+	if (nextSlot != 0)
+	{
+		result = at24c32_read_seq(nextSlot, &seq);
+		if (result != AT24C32_OK)
+		{
+			return (result);
+		}
+
+		if (seq == SEQ_ERASED)
+		{
+			records = nextSlot;
+		}
+	}
+
+	return (AT24C32_OK);
+}
+
+uint8_t at24c32_log(const struct time* time_, const uint8_t* data)
+{
+	uint8_t* rec = &pageBuf[3 + (nextSlot % SLOTS_PER_PAGE) * AT24C32_RECORD_SIZE];
+	uint32_t timestamp = cal_to_epoch(time_);
+	uint8_t result;
+	uint8_t i;
+
+	if (pending != 0 && nextSlot % SLOTS_PER_PAGE == 0)
+	{
+		// The previous page failed to flush; it must be written before the buffer is reused
+		result = at24c32_flush();
+		if (result != AT24C32_OK)
+		{
+			return (result);
+		}
+	}
+
+	rec[0] = nextSeq & 0xFF;
+	rec[1] = nextSeq >> 8;
+	rec[2] = timestamp & 0xFF;
+	rec[3] = (timestamp >> 8) & 0xFF;
+	rec[4] = (timestamp >> 16) & 0xFF;
+	rec[5] = timestamp >> 24;
+	for (i = 0; i < AT24C32_DATA_SIZE; i++)
+	{
+		rec[6 + i] = data[i];
+	}
+
+	if (pending == 0)
+	{
+		firstPending = nextSlot;
+	}
+	pending++;
+
+	nextSlot = (nextSlot + 1) % AT24C32_RECORDS;
+	nextSeq = seq_add(nextSeq, 1);
+	if (records < AT24C32_RECORDS)
+	{
+		records++;
+	}
+
+	if (nextSlot % SLOTS_PER_PAGE == 0)
+	{
+		// Page is full
+		return (at24c32_flush());
+	}
+
+	return (AT24C32_OK);
+}
+
+uint8_t at24c32_flush(void)
+{
+	uint16_t addr = firstPending * AT24C32_RECORD_SIZE;
+	uint8_t* msgBuf;
+	uint8_t result;
+
+	if (pending == 0)
+	{
+		return (AT24C32_OK);
+	}
+
+	result = at24c32_wait();
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	// Bytes before the first buffered record are already written, so the
+	// transmission header can overwrite them
+	msgBuf = &pageBuf[addr % AT24C32_PAGE_SIZE];
+	msgBuf[0] = WRITE_ADD;
+	msgBuf[1] = addr >> 8;
+	msgBuf[2] = addr & 0xFF;
+	if (!TWI_device_transceive(&at24c32_device, msgBuf, 3 + pending * AT24C32_RECORD_SIZE))
+	{
+		// Handle transmission error
+		return (AT24C32_ERR_BUS);
+	}
+
+	pending = 0;
+	writeCycle = true;
+
+	return (AT24C32_OK);
+}
+
+uint8_t at24c32_read(uint16_t age, struct at24c32_record* record)
+{
+	uint8_t msgBuf[1 + AT24C32_RECORD_SIZE];
+	uint16_t slot;
+	uint8_t result;
+	uint8_t i;
+
+	if (age >= records)
+	{
+		return (AT24C32_ERR_PARAM);
+	}
+
+	result = at24c32_flush();
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	slot = (nextSlot + AT24C32_RECORDS - 1 - age) % AT24C32_RECORDS;
+	result = at24c32_read_bytes(slot * AT24C32_RECORD_SIZE, msgBuf, AT24C32_RECORD_SIZE);
+	if (result != AT24C32_OK)
+	{
+		return (result);
+	}
+
+	record->seq = msgBuf[1] | (msgBuf[2] << 8);
+	record->timestamp = msgBuf[3] | ((uint32_t)msgBuf[4] << 8) | ((uint32_t)msgBuf[5] << 16) | ((uint32_t)msgBuf[6] << 24);
+	for (i = 0; i < AT24C32_DATA_SIZE; i++)
+	{
+		record->data[i] = msgBuf[7 + i];
+	}
+
+	return (AT24C32_OK);
+}
+
+uint16_t at24c32_count(void)
+{
+	return (records);
+}
@@ -0,0 +1,121 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file at24c32.h
+ * @brief Circular record logger for the AT24C32 EEPROM found on most DS3231 boards.
+ *
+ * Records of AT24C32_RECORD_SIZE bytes are appended around the whole EEPROM, so every
+ * cell is written once per lap. Records are collected in a RAM page buffer and written
+ * with one page write per EEPROM page (or per at24c32_flush() call). The end of the
+ * write cycle is detected by polling for an address ACK before the next transmission,
+ * so at24c32_log() does not wait for the write to finish.
+ *
+ * Each record starts with a 16-bit sequence number; at24c32_init() finds the newest
+ * record by binary search over the sequence numbers.
+ */
+
+#ifndef AT24C32_H_
+#define AT24C32_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+#include "ds3231.h"
+#include "twi.h"
+
+#ifndef AT24C32_ADDRESS
+	#define AT24C32_ADDRESS 0x57                 //!< 7-bit bus address; 0x50 + A2..A0 (all pulled high on most boards).
+#endif
+
+#define AT24C32_SIZE      4096                   //!< EEPROM size in bytes.
+#define AT24C32_PAGE_SIZE 32                     //!< EEPROM page size in bytes.
+
+#ifndef AT24C32_RECORD_SIZE
+	#define AT24C32_RECORD_SIZE 16               //!< Record size in bytes; a power of two in [8;32], so records never cross pages.
+#endif
+
+#define AT24C32_DATA_SIZE (AT24C32_RECORD_SIZE - 6)                //!< Payload bytes per record.
+#define AT24C32_RECORDS   (AT24C32_SIZE / AT24C32_RECORD_SIZE)     //!< Number of record slots.
+
+#ifndef AT24C32_POLL_LIMIT
+	#define AT24C32_POLL_LIMIT 100               //!< Number of ACK polls before a write cycle is considered failed.
+#endif
+#ifndef AT24C32_POLL_DELAY_US
+	#define AT24C32_POLL_DELAY_US 100            //!< Delay between ACK polls in microseconds.
+#endif
+
+// Result codes
+#define AT24C32_OK          0                    //!< Operation completed successfully.
+#define AT24C32_ERR_PARAM   1                    //!< Invalid argument.
+#define AT24C32_ERR_BUS     2                    //!< Transmission failed.
+#define AT24C32_ERR_TIMEOUT 3                    //!< The EEPROM did not finish its write cycle in time.
+
+/**A log record.
+ *
+ */
+struct at24c32_record {
+	uint16_t seq;                                //!< Sequence number; 0xFFFF marks an erased slot.
+	uint32_t timestamp;                          //!< Seconds since 2000-01-01 00:00:00 (see calendar.h).
+	uint8_t data[AT24C32_DATA_SIZE];             //!< Payload.
+};
+
+extern struct TWI_device at24c32_device;         //!< Bus handle of the AT24C32: its address and, with TWI_STATISTICS, its bus usage counters.
+
+/**Finds the newest record, so that logging continues after it.
+ *
+ * @return                   Returns AT24C32_OK on success, otherwise an AT24C32_ERR_* code.
+ */
+uint8_t at24c32_init(void);
+/**Appends a record to the log.
+ *
+ * The record is written to the EEPROM once its page in the RAM buffer is full,
+ * or when at24c32_flush() is called.
+ *
+ * @param[in]     time_      Time stamp of the record.
+ * @param[in]     data       AT24C32_DATA_SIZE bytes of payload.
+ *
+ * @return                   Returns AT24C32_OK on success, otherwise an AT24C32_ERR_* code.
+ */
+uint8_t at24c32_log(const struct time* time_, const uint8_t* data);
+/**Writes all buffered records to the EEPROM.
+ *
+ * @return                   Returns AT24C32_OK on success, otherwise an AT24C32_ERR_* code.
+ */
+uint8_t at24c32_flush(void);
+/**Reads a record, flushing buffered records first.
+ *
+ * @param[in]     age        Age of the record; 0 is the newest.
+ * @param[out]    record     Record struct to which to copy the record.
+ *
+ * @return                   Returns AT24C32_OK on success, AT24C32_ERR_PARAM if there is no such record,
+ *                           otherwise an AT24C32_ERR_* code.
+ */
+uint8_t at24c32_read(uint16_t age, struct at24c32_record* record);
+/**Gets the number of records in the log.
+ *
+ * @return                   Returns the number of records, at most AT24C32_RECORDS.
+ */
+uint16_t at24c32_count(void);
+
+#endif /* AT24C32_H_ */
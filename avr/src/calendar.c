@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file calendar.c
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "calendar.h"
+
+#define SECONDS_PER_DAY 86400UL                  //!< Number of seconds in a day.
+#define DAYS_PER_CYCLE  1461                     //!< Number of days in four years, starting with a leap year.
+
+static const uint8_t monthDays[] PROGMEM = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+static const uint8_t weekdayOffset[] PROGMEM = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+
+bool cal_is_leap(uint8_t year)
+{
+	// 1900 is the only year in range that is divisible by 4 but not a leap year
+	return ((year % 4) == 0 && year != 0);
+}
+
+uint8_t cal_days_in_month(uint8_t year, uint8_t mon)
+{
+	return (pgm_read_byte(&monthDays[mon - 1]) + ((mon == 2 && cal_is_leap(year)) ? 1 : 0));
+}
+
+uint8_t cal_weekday(const struct time* time_)
+{
+	// Sakamoto's method, with the year counted from March
+	uint16_t year = 1900 + time_->year - ((time_->mon < 3) ? 1 : 0);
+
+	return ((year + year / 4 - year / 100 + year / 400 + pgm_read_byte(&weekdayOffset[time_->mon - 1]) + time_->mday) % 7 + 1);
+}
+
+bool cal_is_valid(const struct time* time_)
+{
+	if (time_->sec > 59 || time_->min > 59 || time_->hour > 23)
+	{
+
+		return (false);
+	}
+	if (time_->year > 199 || time_->mon < 1 || time_->mon > 12)
+	{
+
+		return (false);
+	}
+	if (time_->mday < 1 || time_->mday > cal_days_in_month(time_->year, time_->mon))
+	{
+
+		return (false);
+	}
+
+	return (true);
+}
+
+uint32_t cal_to_epoch(const struct time* time_)
+{
+	uint32_t days = CAL_DAYS(time_->year - 100, time_->mon, time_->mday);
+
+	return (days * SECONDS_PER_DAY + time_->hour * 3600UL + time_->min * 60 + time_->sec);
+}
+
+void cal_from_epoch(uint32_t epoch, struct time* time_)
+{
+	uint16_t days = epoch / SECONDS_PER_DAY;
+	uint32_t secs = epoch % SECONDS_PER_DAY;
+	uint16_t doy;
+	uint8_t year;
+	uint8_t leap;
+	uint8_t mon;
+
+	time_->sec = secs % 60;
+	time_->min = (secs / 60) % 60;
+	time_->hour = secs / 3600;
+	time_->twelveHour = (time_->hour < 12) ? time_->hour : time_->hour - 12;
+	time_->am = time_->hour < 12;
+
+	time_->wday = (days + 6) % 7 + 1;            // 2000-01-01 was a Saturday
+
+	// Year within the four year cycle; the first year of each cycle is a leap year
+	doy = days % DAYS_PER_CYCLE;
+	year = (days / DAYS_PER_CYCLE) * 4;
+	if (doy < 366)
+	{
+		leap = 1;
+	}
+	else
+	{
+		year += (doy - 1) / 365;
+		doy = (doy - 1) % 365;
+		leap = 0;
+	}
+
+	// doy / 32 is at most one month short of the month containing doy
+	mon = doy / 32 + 1;
+	if (mon < 12 && doy >= CAL_DAYS_BEFORE(mon + 1) + ((mon + 1 > 2) ? leap : 0))
+	{
+		mon++;
+	}
+
+	time_->mon = mon;
+	time_->mday = doy - CAL_DAYS_BEFORE(mon) - ((mon > 2) ? leap : 0) + 1;
+	time_->year = year + 100;
+}
+
+
+void cal_add_seconds(struct time* time_, int32_t secs)
+{
+	cal_from_epoch(cal_to_epoch(time_) + secs, time_);
+}
+
+void cal_add_minutes(struct time* time_, int32_t mins)
+{
+	cal_add_seconds(time_, mins * 60);
+}
+
+void cal_add_days(struct time* time_, int16_t days)
+{
+	cal_add_seconds(time_, days * (int32_t)SECONDS_PER_DAY);
+}
+
+int32_t cal_diff(const struct time* a, const struct time* b)
+{
+	return (cal_to_epoch(a) - cal_to_epoch(b));
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file calendar.h
+ * @brief Calendar arithmetic on struct time.
+ *
+ * Validation and weekday calculation cover the full DS3231 range (1900..2099).
+ * Conversion to and from seconds since 2000-01-01 00:00:00, and therefore all
+ * arithmetic, is valid for the years 2000..2099, the range in which every fourth
+ * year is a leap year. None of the functions loop.
+ */
+
+#ifndef CALENDAR_H_
+#define CALENDAR_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+#include "ds3231.h"
+
+/**Number of days before the first day of month m (1..12) in a common year.
+ *
+ */
+#define CAL_DAYS_BEFORE(m) (31 * ((m) - 1) - (((m) > 2) ? (4 * (m) + 23) / 10 : 0))
+
+/**Number of days from 2000-01-01 to the given date.
+ *
+ * A constant expression when all arguments are constants.
+ *
+ * @param[in]     y          Years since 2000 [0;99].
+ * @param[in]     m          Month [1;12].
+ * @param[in]     d          Date [1;31].
+ */
+#define CAL_DAYS(y, m, d) \
+	((uint32_t)(y) * 365 + ((y) + 3) / 4 + CAL_DAYS_BEFORE(m) + ((((y) % 4) == 0 && (m) > 2) ? 1 : 0) + (d) - 1)
+
+/**Checks whether a year is a leap year.
+ *
+ * @param[in]     year       Years since 1900 [0;199].
+ *
+ * @return                   Returns true if the year has 366 days.
+ */
+bool cal_is_leap(uint8_t year);
+/**Gets the number of days in a month.
+ *
+ * @param[in]     year       Years since 1900 [0;199].
+ * @param[in]     mon        Month [1;12].
+ *
+ * @return                   Returns the number of days in the month.
+ */
+uint8_t cal_days_in_month(uint8_t year, uint8_t mon);
+/**Calculates the day of the week of a date.
+ *
+ * @param[in]     time_      The date (mday, mon and year are used).
+ *
+ * @return                   Returns the day of the week [1;7], 1 being Sunday.
+ */
+uint8_t cal_weekday(const struct time* time_);
+/**Checks that all date and time fields are within range.
+ *
+ * wday and the 12-hour fields are not checked.
+ *
+ * @param[in]     time_      The time to check.
+ *
+ * @return                   Returns true if the time is valid.
+ */
+bool cal_is_valid(const struct time* time_);
+/**Converts a time to seconds since 2000-01-01 00:00:00.
+ *
+ * @param[in]     time_      The time to convert (years since 1900 [100;199]).
+ *
+ * @return                   Returns the number of seconds since 2000-01-01 00:00:00.
+ */
+uint32_t cal_to_epoch(const struct time* time_);
+/**Converts seconds since 2000-01-01 00:00:00 to a time.
+ *
+ * All fields are set, including wday (1 = Sunday) and the 12-hour fields.
+ *
+ * @param[in]     epoch      Seconds since 2000-01-01 00:00:00.
+ * @param[out]    time_      Time struct to which to copy the time.
+ */
+void cal_from_epoch(uint32_t epoch, struct time* time_);
+/**Adds seconds to a time.
+ *
+ * All fields, including wday and the 12-hour fields, are updated.
+ *
+ * @param[in,out] time_      The time to change.
+ * @param[in]     secs       Number of seconds to add; may be negative.
+ */
+void cal_add_seconds(struct time* time_, int32_t secs);
+/**Adds minutes to a time.
+ *
+ * @param[in,out] time_      The time to change.
+ * @param[in]     mins       Number of minutes to add; may be negative.
+ */
+void cal_add_minutes(struct time* time_, int32_t mins);
+/**Adds days to a time.
+ *
+ * @param[in,out] time_      The time to change.
+ * @param[in]     days       Number of days to add; may be negative.
+ */
+void cal_add_days(struct time* time_, int16_t days);
+/**Calculates the difference between two times.
+ *
+ * @param[in]     a          The later time.
+ * @param[in]     b          The earlier time.
+ *
+ * @return                   Returns a - b in seconds.
+ */
+int32_t cal_diff(const struct time* a, const struct time* b);
+
+#endif /* CALENDAR_H_ */
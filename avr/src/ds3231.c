@@ -66,20 +66,191 @@ SOFTWARE.
  */
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/delay.h>
 #include "ds3231.h"
+#include "calendar.h"
 #include "twi.h"
 
-#define READ_ADD    0xD1                         //!< The slave address of DS3231 with the LSB set to 1.
-#define WRITE_ADD   0xD0                         //!< The slave address of DS3231 with the LSB set to 0.
+#define WRITE_ADD   (DS3231_ADDRESS << 1)        //!< The slave address of DS3231 with the LSB set to 0 (the address bits are replaced from ds3231_device).
 #define SECDR       0x00                         //!< Address of the "Seconds" register.
+#define HRSDR       0x02                         //!< Address of the "Hours" register.
 #define AL1DR       0X07                         //!< Address of the "Alarm 1 seconds" register.
+#define A1HDR       0x09                         //!< Address of the "Alarm 1 hours" register.
 #define AL2DR       0x0B                         //!< Address of the "Alarm 2 minutes" register.
+#define A2HDR       0x0C                         //!< Address of the "Alarm 2 hours" register.
 #define CTRDR       0x0E                         //!< Address of the "Control" register.
 #define STSDR       0x0F                         //!< Address of the "Status" register.
 #define AGODR       0x10                         //!< Address of the "Aging Offset" register.
 #define TMPDR       0x11                         //!< Address of the "Temperature MSB" register.
 
+#if DS3231_RETRIES > 16
+	#error "DS3231_RETRIES must not exceed 16, the backoff doubles a 16-bit wait count per retry"
+#endif
+#if DS3231_POLL_LIMIT < 1 || DS3231_POLL_LIMIT > 65535
+	#error "DS3231_POLL_LIMIT must be within [1;65535]"
+#endif
+
+#ifndef DS3231_TRANSFER
+	#define DS3231_TRANSFER(msg, size) TWI_device_transceive(&ds3231_device, (msg), (size)) //!< Bus function used for all transfers; may be overridden when compiling.
+#endif
+#ifndef DS3231_WRITE_READ
+	#define DS3231_WRITE_READ(msg, writeSize, readSize) TWI_device_write_read(&ds3231_device, (msg), (writeSize), (readSize)) //!< Bus function used for register reads; may be overridden when compiling.
+#endif
+
+/**Alarm register mask bits for each alarm mode (see DS3231_ALARM_BITS).
+ *
+ */
+static const uint8_t alarmBits[] PROGMEM = {
+	DS3231_ALARM_BITS(ALARM_SEC),
+	DS3231_ALARM_BITS(ALARM_SEC_M),
+	DS3231_ALARM_BITS(ALARM_MIN_M),
+	DS3231_ALARM_BITS(ALARM_HOUR_M),
+	DS3231_ALARM_BITS(ALARM_MDAY_M),
+	DS3231_ALARM_BITS(ALARM_WDAY_M),
+	DS3231_ALARM_BITS(ALARM_MIN)
+};
+
+// Transaction script opcodes; each is followed by two argument bytes (see ds3231_run)
+#define SCR_END     0x00                         //!< End of script (no arguments).
+#define SCR_READ    0x01                         //!< Read registers into the buffer: first register, count.
+#define SCR_WRITE   0x02                         //!< Write the buffer to registers: first register, count.
+#define SCR_AND     0x03                         //!< AND a buffered register with a mask: buffer index, mask.
+#define SCR_OR      0x04                         //!< OR a buffered register with a mask: buffer index, mask.
+#define SCR_AND_ARG 0x05                         //!< Clear the script argument bits in a buffered register: buffer index, unused.
+#define SCR_OR_ARG  0x06                         //!< Set the script argument bits in a buffered register: buffer index, unused.
+#define SCR_FILL    0x07                         //!< Fill the buffer: count, value.
+#define SCR_POLL    0x08                         //!< Read a register until the masked bits are clear, at most DS3231_POLL_LIMIT times: register, mask.
+
+#define SCR_MAX_REGS 4                           //!< Largest number of registers a script may read or write at once.
+
+/**Enables the battery-backed square-wave output and disables alarm interrupts.
+ *
+ */
+static const uint8_t scriptSQWOn[] PROGMEM = {
+	SCR_READ,    CTRDR, 1,
+	SCR_OR,      0,     DS3231_CTR_BBSQW,
+	SCR_AND,     0,     (uint8_t)~DS3231_CTR_INTCN,
+	SCR_WRITE,   CTRDR, 1,
+	SCR_END
+};
+
+/**Disables the battery-backed square-wave output.
+ *
+ */
+static const uint8_t scriptSQWOff[] PROGMEM = {
+	SCR_READ,    CTRDR, 1,
+	SCR_AND,     0,     (uint8_t)~DS3231_CTR_BBSQW,
+	SCR_WRITE,   CTRDR, 1,
+	SCR_END
+};
+
+/**Enables the 32 kHz output.
+ *
+ */
+static const uint8_t script32kHzOn[] PROGMEM = {
+	SCR_READ,    STSDR, 1,
+	SCR_OR,      0,     DS3231_STS_EN32KHZ,
+	SCR_WRITE,   STSDR, 1,
+	SCR_END
+};
+
+/**Disables the 32 kHz output.
+ *
+ */
+static const uint8_t script32kHzOff[] PROGMEM = {
+	SCR_READ,    STSDR, 1,
+	SCR_AND,     0,     (uint8_t)~DS3231_STS_EN32KHZ,
+	SCR_WRITE,   STSDR, 1,
+	SCR_END
+};
+
+/**Clears the alarm 1 registers.
+ *
+ */
+static const uint8_t scriptResetAlarm1[] PROGMEM = {
+	SCR_FILL,    4,     0x00,
+	SCR_WRITE,   AL1DR, 4,
+	SCR_END
+};
+
+/**Clears the alarm 2 registers.
+ *
+ */
+static const uint8_t scriptResetAlarm2[] PROGMEM = {
+	SCR_FILL,    3,     0x00,
+	SCR_WRITE,   AL2DR, 3,
+	SCR_END
+};
+
+/**Clears the alarm flags given as the argument, releasing the INT pin.
+ *
+ */
+static const uint8_t scriptClearFlags[] PROGMEM = {
+	SCR_READ,    STSDR, 1,
+	SCR_AND_ARG, 0,     0,
+	SCR_WRITE,   STSDR, 1,
+	SCR_END
+};
+
+/**Starts a temperature conversion once the DS3231 is not busy.
+ *
+ */
+static const uint8_t scriptConvert[] PROGMEM = {
+	SCR_POLL,    STSDR, DS3231_STS_BSY,
+	SCR_READ,    CTRDR, 1,
+	SCR_OR,      0,     DS3231_CTR_CONV,
+	SCR_WRITE,   CTRDR, 1,
+	SCR_END
+};
+
+/**Starts a temperature conversion and waits for it to complete.
+ *
+ */
+static const uint8_t scriptConvertBlock[] PROGMEM = {
+	SCR_POLL,    STSDR, DS3231_STS_BSY,
+	SCR_READ,    CTRDR, 1,
+	SCR_OR,      0,     DS3231_CTR_CONV,
+	SCR_WRITE,   CTRDR, 1,
+	SCR_POLL,    CTRDR, DS3231_CTR_CONV,
+	SCR_END
+};
+
 struct time _time;
+struct TWI_device ds3231_device = { .address = DS3231_ADDRESS };
+
+static volatile bool ds3231Busy;                 //!< Set while a register access (pointer write and read, or write) is in progress.
+static bool oscStopped;                          //!< Set by ds3231_init() when the oscillator stop flag was found set.
+static bool hour12;                              //!< Set while the DS3231 keeps hours in 12-hour mode.
+static bool hourModeKnown;                       //!< Set once hour12 has been read from the DS3231 or set by ds3231_set_12h_mode().
+
+#ifdef DS3231_REG_CACHE
+static bool controlValid;                        //!< Set once control holds the "Control" register.
+static uint8_t control;                          //!< Copy of the "Control" register, without the self-clearing CONV bit.
+#endif
+
+#ifdef DS3231_BATCH
+#define BATCH_COUNT (STSDR - AL1DR + 1)          //!< Number of registers buffered in a batch.
+#define BATCH_FLAGS (DS3231_STS_OSF | DS3231_STS_A2F | DS3231_STS_A1F) //!< "Status" flags that can only be cleared by writing 0.
+#define BATCH_ALARM_FLAGS (DS3231_STS_A2F | DS3231_STS_A1F) //!< Flags buffered as 1 (unchanged when written), as they may be raised at any time.
+#define BATCH_ACTIVE batchActive
+
+static bool batchActive;                         //!< Set between ds3231_begin_update() and ds3231_commit().
+static bool batchLoaded;                         //!< Set once batchBuf holds the registers.
+static uint16_t batchDirty;                      //!< Bit n is set when register AL1DR + n was changed in the batch.
+static uint8_t batchCleared;                     //!< "Status" flags cleared in the batch.
+static uint8_t batchBuf[1 + BATCH_COUNT];        //!< Copy of the registers AL1DR..STSDR, kept from batchBuf[1].
+#else
+#define BATCH_ACTIVE false
+#endif
+
+#ifdef DS3231_TIME_CACHE
+static volatile bool cacheValid;                 //!< Whether _time holds the current second.
+static volatile uint8_t cacheTicks;              //!< Ticks counted since the last refresh.
+static uint16_t cacheHits;                       //!< Number of time reads served from the cache.
+static uint16_t cacheMisses;                     //!< Number of time reads that refreshed the cache.
+#endif
 
 /**Converts a decimal value to a binary coded decimal value.
  *
@@ -92,307 +263,1178 @@ uint8_t dec2bcd(uint8_t d)
 	return ((d / 10 * 16) + (d % 10));
 }
 
-/**Converts a binary coded decimal value to a decimal value.
- *
- * @param[in]    d           Binary coded decimal value to convert.
- *
- * @return                   Returns a decimal value of b.
- */
-uint8_t bcd2dec(uint8_t b)
-{
-	return ((b / 16 * 10) + (b % 16));
+/**Converts a binary coded decimal value to a decimal value.
+ *
+ * @param[in]    d           Binary coded decimal value to convert.
+ *
+ * @return                   Returns a decimal value of b.
+ */
+uint8_t bcd2dec(uint8_t b)
+{
+	return ((b / 16 * 10) + (b % 16));
+}
+
+/**Encodes an hour [0;23] for an hours register.
+ *
+ * @param[in]     hour       The hour to encode.
+ * @param[in]     twelve     Whether to encode in 12-hour mode (Bit6 set, Bit5 PM, hours 1..12).
+ */
+static uint8_t ds3231_hour_encode(uint8_t hour, bool twelve)
+{
+	if (!twelve)
+	{
+		return (dec2bcd(hour));
+	}
+
+	return (0x40 | ((hour >= 12) ? 0x20 : 0x00) | dec2bcd((hour % 12 == 0) ? 12 : hour % 12));
+}
+
+/**Decodes an hours register in either mode to an hour [0;23].
+ *
+ * @param[in]     reg        The register value, without the alarm mask bit.
+ */
+static uint8_t ds3231_hour_decode(uint8_t reg)
+{
+	if (!(reg & 0x40))
+	{
+		return (bcd2dec(reg & 0x3F));
+	}
+
+	return (bcd2dec(reg & 0x1F) % 12 + ((reg & 0x20) ? 12 : 0));
+}
+
+/**Translates the error information of the last transmission into a result code.
+ *
+ * @return                   Returns DS3231_ERR_BUSY if the transmission was rejected (TWI_is_busy()),
+ *                           otherwise the DS3231_ERR_* code matching TWI_get_state_info().
+ */
+static uint8_t ds3231_result(void)
+{
+	if (TWI_is_busy())
+	{
+		// Rejected without using the bus: another transmission is in progress
+		return (DS3231_ERR_BUSY);
+	}
+
+	switch (TWI_get_state_info())
+	{
+		case TWI_NO_ACK_ON_ADDRESS:
+			return (DS3231_ERR_NACK);
+		case TWI_NO_ACK_ON_DATA:
+			return (DS3231_ERR_DATA);
+		case TWI_UE_START_CON:
+		case TWI_UE_STOP_CON:
+		case TWI_UE_DATA_COL:
+		case TWI_MISSING_START_CON:
+		case TWI_MISSING_STOP_CON:
+			return (DS3231_ERR_BUS);
+		default:
+			// TWI_DATA_OUT_OF_BOUND, TWI_NO_DATA
+			return (DS3231_ERR_FAULT);
+	}
+}
+
+/**Decides whether a failed transmission should be retried, and waits before the retry.
+ *
+ * Only transient errors (address NACK, bus errors) are retried, up to DS3231_RETRIES
+ * times, waiting DS3231_RETRY_DELAY_US before the first retry and twice as long before
+ * each further one.
+ *
+ * @param[in]     result     Result code of the failed attempt.
+ * @param[in]     attempt    Number of attempts made so far, starting at 1.
+ *
+ * @return                   Returns TRUE (1) if the transmission should be retried, otherwise FALSE (0).
+ */
+static bool ds3231_retry(uint8_t result, uint8_t attempt)
+{
+	uint16_t wait;
+
+	if ((result != DS3231_ERR_NACK && result != DS3231_ERR_BUS) || attempt > DS3231_RETRIES)
+	{
+		return (false);
+	}
+
+	for (wait = 1U << (attempt - 1); wait; wait--)
+	{
+		_delay_us(DS3231_RETRY_DELAY_US);
+	}
+
+	return (true);
+}
+
+#ifdef DS3231_REG_CACHE
+/**Updates the copy of the "Control" register if it lies within the given registers.
+ *
+ * @param[in]     reg        Address of the first register.
+ * @param[in]     regs       Register values.
+ * @param[in]     count      Number of registers.
+ */
+static void ds3231_cache_control(uint8_t reg, const uint8_t* regs, uint8_t count)
+{
+	if (reg <= CTRDR && reg + count > CTRDR)
+	{
+		control = regs[CTRDR - reg] & ~DS3231_CTR_CONV;
+		controlValid = true;
+	}
+}
+#endif
+
+/**Reads consecutive registers from the DS3231 in a single burst, bypassing a batch.
+ *
+ * @param[in]     reg        Address of the first register to read.
+ * @param[out]    msgBuf     Transmission buffer of at least count + 1 bytes. Register values are stored from msgBuf[1].
+ * @param[in]     count      Number of registers to read.
+ *
+ * @return                   Returns DS3231_OK if the registers were read successfully, otherwise an error code.
+ *                           Fails with DS3231_ERR_BUSY without using the bus if another access is in progress.
+ */
+static uint8_t ds3231_bus_read_regs(uint8_t reg, uint8_t* msgBuf, uint8_t count)
+{
+	bool busy;
+	uint8_t result;
+	uint8_t attempt = 0;
+
+	// Keep the register pointer ours until the read completes
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		busy = ds3231Busy;
+		ds3231Busy = true;
+	}
+	if (busy)
+	{
+		return (DS3231_ERR_BUSY);
+	}
+
+	do
+	{
+		// Write the address of the first register to read, then read the registers after a repeated Start Condition
+		msgBuf[0] = WRITE_ADD;
+		msgBuf[1] = reg;
+		result = DS3231_WRITE_READ(msgBuf, 2, count) ? DS3231_OK : ds3231_result();
+	} while (result != DS3231_OK && ds3231_retry(result, ++attempt));
+
+#ifdef DS3231_REG_CACHE
+	if (result == DS3231_OK)
+	{
+		ds3231_cache_control(reg, &msgBuf[1], count);
+	}
+#endif
+	ds3231Busy = false;
+
+	return (result);
+}
+
+/**Writes a prepared transmission buffer to the DS3231, bypassing a batch.
+ *
+ * @param[in]     msgBuf     Transmission buffer; msgBuf[0] holds WRITE_ADD, msgBuf[1] the first register address, followed by the data.
+ * @param[in]     msgSize    Number of bytes in the transmission buffer.
+ *
+ * @return                   Returns DS3231_OK if the registers were written successfully, otherwise an error code.
+ *                           Fails with DS3231_ERR_BUSY without using the bus if another access is in progress.
+ */
+static uint8_t ds3231_bus_write_regs(uint8_t* msgBuf, uint8_t msgSize)
+{
+	bool busy;
+	uint8_t result;
+	uint8_t attempt = 0;
+
+	// A write moves the register pointer, so it must not run between the pointer write and read of another access
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		busy = ds3231Busy;
+		ds3231Busy = true;
+	}
+	if (busy)
+	{
+		return (DS3231_ERR_BUSY);
+	}
+
+	do
+	{
+		result = DS3231_TRANSFER(msgBuf, msgSize) ? DS3231_OK : ds3231_result();
+	} while (result != DS3231_OK && ds3231_retry(result, ++attempt));
+
+#ifdef DS3231_REG_CACHE
+	if (result == DS3231_OK)
+	{
+		ds3231_cache_control(msgBuf[1], &msgBuf[2], msgSize - 2);
+	}
+#endif
+	ds3231Busy = false;
+
+	return (result);
+}
+
+#ifdef DS3231_BATCH
+/**Reads the registers buffered in a batch, unless already done.
+ *
+ */
+static uint8_t ds3231_batch_load(void)
+{
+	uint8_t result;
+
+	if (batchLoaded)
+	{
+		return (DS3231_OK);
+	}
+
+	result = ds3231_bus_read_regs(AL1DR, batchBuf, BATCH_COUNT);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+	batchBuf[1 + CTRDR - AL1DR] &= ~DS3231_CTR_CONV; // Self-clearing; set only to start a conversion
+	batchBuf[1 + STSDR - AL1DR] |= BATCH_ALARM_FLAGS;
+	batchLoaded = true;
+
+	return (DS3231_OK);
+}
+
+/**Updates the buffered copy of the registers that lie within the given registers.
+ *
+ * @param[in]     reg        Address of the first register.
+ * @param[in]     regs       Register values as read from or written to the DS3231.
+ * @param[in]     count      Number of registers.
+ */
+static void ds3231_batch_update(uint8_t reg, const uint8_t* regs, uint8_t count)
+{
+	for (; count; reg++, regs++, count--)
+	{
+		if (reg == CTRDR)
+		{
+			batchBuf[1 + reg - AL1DR] = *regs & ~DS3231_CTR_CONV;
+		}
+		else if (reg == STSDR)
+		{
+			batchBuf[1 + reg - AL1DR] = *regs | BATCH_ALARM_FLAGS;
+		}
+		else if (reg >= AL1DR && reg < STSDR)
+		{
+			batchBuf[1 + reg - AL1DR] = *regs;
+		}
+	}
+}
+
+/**Writes the changed registers of a batch to the DS3231.
+ *
+ * The registers from the first to the last changed one are written in a single burst.
+ * Unchanged registers in between are rewritten with their current values, which costs
+ * less than another transmission; the "Status" flags are written as 1, leaving them
+ * unchanged, unless they were cleared in the batch.
+ *
+ * @return                   Returns DS3231_OK if the registers were written successfully, otherwise an error code.
+ */
+static uint8_t ds3231_batch_flush(void)
+{
+	uint8_t msgBuf[2 + BATCH_COUNT];
+	uint8_t first;
+	uint8_t last;
+	uint8_t i;
+	uint8_t result;
+
+	if (!batchDirty)
+	{
+		return (DS3231_OK);
+	}
+
+	first = 0;
+	while (!(batchDirty & (1 << first)))
+	{
+		first++;
+	}
+	last = BATCH_COUNT - 1;
+	while (!(batchDirty & (1 << last)))
+	{
+		last--;
+	}
+
+	msgBuf[0] = WRITE_ADD;
+	msgBuf[1] = AL1DR + first;
+	for (i = first; i <= last; i++)
+	{
+		msgBuf[2 + i - first] = batchBuf[1 + i];
+	}
+	if (last == STSDR - AL1DR)
+	{
+		msgBuf[2 + last - first] |= BATCH_FLAGS & ~batchCleared;
+	}
+
+	result = ds3231_bus_write_regs(msgBuf, 2 + last - first + 1);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+
+	batchDirty = 0;
+	batchCleared = 0;
+	batchBuf[1 + CTRDR - AL1DR] &= ~DS3231_CTR_CONV;
+	batchBuf[1 + STSDR - AL1DR] |= BATCH_ALARM_FLAGS;
+
+	return (DS3231_OK);
+}
+
+void ds3231_begin_update(void)
+{
+	if (batchActive)
+	{
+		return;
+	}
+
+	batchLoaded = false;
+	batchDirty = 0;
+	batchCleared = 0;
+	batchActive = true;
+}
+
+uint8_t ds3231_commit(void)
+{
+	uint8_t result;
+
+	if (!batchActive)
+	{
+		return (DS3231_OK);
+	}
+
+	result = ds3231_batch_flush();
+	batchActive = false;
+
+	return (result);
+}
+#endif
+
+/**Reads consecutive registers from the DS3231 in a single burst.
+ *
+ * In a batch, registers within AL1DR..STSDR are read from the buffered copy.
+ *
+ * @param[in]     reg        Address of the first register to read.
+ * @param[out]    msgBuf     Transmission buffer of at least count + 1 bytes. Register values are stored from msgBuf[1].
+ * @param[in]     count      Number of registers to read.
+ *
+ * @return                   Returns DS3231_OK if the registers were read successfully, otherwise an error code.
+ */
+static uint8_t ds3231_read_regs(uint8_t reg, uint8_t* msgBuf, uint8_t count)
+{
+#ifdef DS3231_BATCH
+	uint8_t result;
+	uint8_t i;
+
+	if (batchActive && reg + count > AL1DR && reg <= STSDR)
+	{
+		if (reg >= AL1DR && reg + count <= STSDR + 1)
+		{
+			result = ds3231_batch_load();
+			for (i = 0; result == DS3231_OK && i < count; i++)
+			{
+				msgBuf[1 + i] = batchBuf[1 + reg - AL1DR + i];
+			}
+			return (result);
+		}
+
+		// Partly buffered: let the DS3231 see the changes first
+		result = ds3231_batch_flush();
+		if (result == DS3231_OK)
+		{
+			result = ds3231_bus_read_regs(reg, msgBuf, count);
+		}
+		if (result == DS3231_OK && batchLoaded)
+		{
+			ds3231_batch_update(reg, &msgBuf[1], count);
+		}
+		return (result);
+	}
+#endif
+
+	return ds3231_bus_read_regs(reg, msgBuf, count);
+}
+
+/**Writes a prepared transmission buffer to the DS3231.
+ *
+ * In a batch, writes within AL1DR..STSDR only change the buffered copy.
+ *
+ * @param[in]     msgBuf     Transmission buffer; msgBuf[0] holds WRITE_ADD, msgBuf[1] the first register address, followed by the data.
+ * @param[in]     msgSize    Number of bytes in the transmission buffer.
+ *
+ * @return                   Returns DS3231_OK if the registers were written successfully, otherwise an error code.
+ */
+static uint8_t ds3231_write_regs(uint8_t* msgBuf, uint8_t msgSize)
+{
+#ifdef DS3231_BATCH
+	uint8_t reg = msgBuf[1];
+	uint8_t count = msgSize - 2;
+	uint8_t* shadow;
+	uint8_t result;
+	uint8_t i;
+
+	if (batchActive && reg + count > AL1DR && reg <= STSDR)
+	{
+		if (reg >= AL1DR && reg + count <= STSDR + 1)
+		{
+			result = ds3231_batch_load();
+			if (result != DS3231_OK)
+			{
+				// Handle transmission error
+				return (result);
+			}
+
+			shadow = &batchBuf[1 + reg - AL1DR];
+			if (reg + count > STSDR)
+			{
+				batchCleared |= shadow[STSDR - reg] & ~msgBuf[2 + STSDR - reg] & BATCH_FLAGS;
+			}
+			for (i = 0; i < count; i++)
+			{
+				shadow[i] = msgBuf[2 + i];
+				batchDirty |= 1 << (reg - AL1DR + i);
+			}
+			return (DS3231_OK);
+		}
+
+		// Partly buffered: keep the order of the changes
+		result = ds3231_batch_flush();
+		if (result == DS3231_OK)
+		{
+			result = ds3231_bus_write_regs(msgBuf, msgSize);
+		}
+		if (result == DS3231_OK && batchLoaded)
+		{
+			ds3231_batch_update(reg, &msgBuf[2], count);
+		}
+		return (result);
+	}
+#endif
+
+	return ds3231_bus_write_regs(msgBuf, msgSize);
+}
+
+/**Runs a transaction script stored in program memory.
+ *
+ * Scripts operate on a buffer of up to SCR_MAX_REGS register values, which are read,
+ * modified and written back by the SCR_* operations.
+ *
+ * @param[in]     script     The script to run.
+ * @param[in]     arg        Argument used by SCR_AND_ARG and SCR_OR_ARG.
+ *
+ * @return                   Returns DS3231_OK if the script completed successfully, otherwise an error code.
+ */
+static uint8_t ds3231_run(const uint8_t* script, uint8_t arg)
+{
+	uint8_t msgBuf[2 + SCR_MAX_REGS];            // Register values are kept from msgBuf[2]
+	uint8_t* regs = &msgBuf[2];
+	uint8_t op;
+	uint8_t a;
+	uint8_t b;
+	uint16_t polls;
+	uint8_t result = DS3231_OK;
+
+	while ((op = pgm_read_byte(script++)) != SCR_END)
+	{
+		a = pgm_read_byte(script++);
+		b = pgm_read_byte(script++);
+
+		switch (op)
+		{
+			case SCR_READ:
+#ifdef DS3231_REG_CACHE
+				if (a == CTRDR && b == 1 && controlValid && !BATCH_ACTIVE)
+				{
+					regs[0] = control;
+					break;
+				}
+#endif
+				result = ds3231_read_regs(a, &msgBuf[1], b);
+				break;
+			case SCR_WRITE:
+				msgBuf[0] = WRITE_ADD;
+				msgBuf[1] = a;
+				result = ds3231_write_regs(msgBuf, b + 2);
+				break;
+			case SCR_AND:
+				regs[a] &= b;
+				break;
+			case SCR_OR:
+				regs[a] |= b;
+				break;
+			case SCR_AND_ARG:
+				regs[a] &= ~arg;
+				break;
+			case SCR_OR_ARG:
+				regs[a] |= arg;
+				break;
+			case SCR_FILL:
+				while (a--)
+				{
+					regs[a] = b;
+				}
+				break;
+			case SCR_POLL:
+				polls = DS3231_POLL_LIMIT;
+				while ((result = ds3231_bus_read_regs(a, &msgBuf[1], 1)) == DS3231_OK && (regs[0] & b))
+				{
+					if (--polls == 0)
+					{
+						// A stuck flag (or a DS3231 that was replaced mid-conversion) must not hang the caller
+						result = DS3231_ERR_TIMEOUT;
+						break;
+					}
+					_delay_us(DS3231_POLL_DELAY_US);
+				}
+				break;
+		}
+
+		if (result != DS3231_OK)
+		{
+			// Handle transmission error
+			return (result);
+		}
+	}
+
+	return (DS3231_OK);
+}
+
+/**Decodes a single timekeeping register into a time struct.
+ *
+ * @param[out]    time_      Time struct in which to store the decoded field.
+ * @param[in]     regs       Register values; regs[0] holds register reg, and for the "Year"
+ *                           register regs[-1] must hold the "Month/Century" register.
+ * @param[in]     reg        Address of the register to decode (SECDR..SECDR + 6).
+ */
+static void ds3231_decode(struct time* time_, uint8_t* regs, uint8_t reg)
+{
+	switch (reg)
+	{
+		case 0:
+			time_->sec = bcd2dec(regs[0]);
+			break;
+		case 1:
+			time_->min = bcd2dec(regs[0]);
+			break;
+		case 2:
+			hour12 = (regs[0] & 0x40) != 0;
+			hourModeKnown = true;
+			if (hour12)
+			{
+				// The 12-hour fields are stored directly; hour is left to ds3231_12h_translate()
+				time_->twelveHour = bcd2dec(regs[0] & 0x1F) % 12;
+				time_->am = !(regs[0] & 0x20);
+			}
+			else
+			{
+				time_->hour = bcd2dec(regs[0] & 0x3F);
+				ds3231_24h_to_12h(time_);
+			}
+			break;
+		case 3:
+			time_->wday = bcd2dec(regs[0]);
+			break;
+		case 4:
+			time_->mday = bcd2dec(regs[0]);
+			break;
+		case 5:
+			time_->mon = bcd2dec(regs[0] & 0x1F);    // Month data is stored in Bit4..0
+			break;
+		case 6:
+			// Century data is stored in Bit7 of the "Month" register
+			time_->year = bcd2dec(regs[0]) + ((regs[-1] & 0x80) ? 100 : 0);
+			break;
+	}
+}
+
+uint8_t ds3231_get_fields(struct time* time_, uint8_t fields)
+{
+	uint8_t msgBuf[8];
+	uint8_t result;
+	uint8_t regs;
+	uint8_t first;
+	uint8_t last;
+	uint8_t reg;
+
+	regs = fields & DS3231_F_ALL;
+	if (regs & DS3231_F_YEAR)
+	{
+		regs |= DS3231_F_MON;                    // The century bit is stored in the "Month" register
+	}
+
+	for (first = 0; first < 7; first = last + 1)
+	{
+		if (!(regs & (1 << first)))
+		{
+			last = first;
+			continue;
+		}
+
+		// Extend the burst over gaps that are cheaper to read than a new pointer write
+		last = first;
+		for (reg = first + 1; reg < 7 && (reg - last - 1) <= DS3231_BURST_GAP; reg++)
+		{
+			if (regs & (1 << reg))
+			{
+				last = reg;
+			}
+		}
+
+		result = ds3231_read_regs(SECDR + first, msgBuf, last - first + 1);
+		if (result != DS3231_OK)
+		{
+			// Handle transmission error
+			return (result);
+		}
+
+		for (reg = first; reg <= last; reg++)
+		{
+			if (fields & (1 << reg))
+			{
+				ds3231_decode(time_, &msgBuf[1 + reg - first], reg);
+			}
+		}
+	}
+
+	return (DS3231_OK);
+}
+
+/**Reads the hour mode from the DS3231, unless it is known already.
+ *
+ * The hour mode survives an MCU reset, so a time or alarm set before the first time
+ * read has to learn it first; it is not read by ds3231_init(), to keep a warm boot
+ * to a single transaction.
+ *
+ * @return                   Returns DS3231_OK if hour12 holds the hour mode, otherwise an error code.
+ */
+static uint8_t ds3231_hour_mode(void)
+{
+	uint8_t msgBuf[2];
+	uint8_t result;
+
+	if (hourModeKnown)
+	{
+		return (DS3231_OK);
+	}
+
+	result = ds3231_read_regs(HRSDR, msgBuf, 1);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+	hour12 = (msgBuf[1] & 0x40) != 0;
+	hourModeKnown = true;
+
+	return (DS3231_OK);
+}
+
+uint8_t ds3231_init(uint8_t controlValue, uint8_t statusValue)
+{
+	uint8_t msgBuf[4];
+	uint8_t result;
+
+	hourModeKnown = false;                       // The DS3231 may have been replaced or reprogrammed
+
+	// Read the "Control" and "Status" registers
+	result = ds3231_read_regs(CTRDR, msgBuf, 2);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+
+	oscStopped = (msgBuf[2] & DS3231_STS_OSF) != 0;
+
+	controlValue &= ~DS3231_CTR_CONV;
+	statusValue = (msgBuf[2] & ~DS3231_STS_EN32KHZ) | (statusValue & DS3231_STS_EN32KHZ);
+	if ((msgBuf[1] & ~DS3231_CTR_CONV) != controlValue || msgBuf[2] != statusValue)
+	{
+		// Write the new settings to the "Control" and "Status" registers
+		msgBuf[0] = WRITE_ADD;
+		msgBuf[1] = CTRDR;
+		msgBuf[2] = controlValue;
+		msgBuf[3] = statusValue;                 // Writing 1 to the flags leaves them unchanged
+		result = ds3231_write_regs(msgBuf, 4);
+		if (result != DS3231_OK)
+		{
+			// Handle transmission error
+			return (result);
+		}
+	}
+
+	return (oscStopped ? DS3231_TIME_INVALID : DS3231_OK);
+}
+
+#ifdef DS3231_TIME_CACHE
+void ds3231_cache_invalidate(void)
+{
+	cacheValid = false;
+}
+
+void ds3231_cache_tick(void)
+{
+	if (++cacheTicks >= DS3231_CACHE_TICKS)
+	{
+		cacheValid = false;
+	}
+}
+
+void ds3231_get_cache_stats(uint16_t* hits, uint16_t* misses)
+{
+	*hits = cacheHits;
+	*misses = cacheMisses;
+}
+
+/**Refreshes the cached time if it has been invalidated.
+ *
+ * @return                   Returns DS3231_OK if _time holds the current time, otherwise an error code.
+ */
+static uint8_t ds3231_cache_update(void)
+{
+	uint8_t result;
+
+	if (cacheValid)
+	{
+		cacheHits++;
+		return (DS3231_OK);
+	}
+
+	cacheMisses++;
+
+	// Mark valid before reading, so an SQW edge during the transaction forces another refresh
+	cacheValid = true;
+	cacheTicks = 0;
+	result = ds3231_get_fields(&_time, DS3231_F_ALL);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		cacheValid = false;
+		return (result);
+	}
+
+	return (DS3231_OK);
+}
+#endif
+
+uint8_t ds3231_get_time(struct time* time_)
+{
+	uint8_t result;
+
+#ifdef DS3231_TIME_CACHE
+	result = ds3231_cache_update();
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+#else
+	// Read register 0x00..0x06 and update stored time
+	result = ds3231_get_fields(&_time, DS3231_F_ALL);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+#endif
+
+	*time_ = _time;
+
+	return (DS3231_OK);
 }
 
-uint8_t ds3231_get_time(struct time* time_)
+uint8_t ds3231_get_time_s(uint8_t* hour, uint8_t* min, uint8_t* sec)
 {
-	uint8_t msgBuf[8];
-	uint8_t century;
+	uint8_t result;
 
-	// Write the address of the first register to read ("Seconds")
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = SECDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+#ifdef DS3231_TIME_CACHE
+	result = ds3231_cache_update();
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
+	}
+
+	if (hour12)
+	{
+		ds3231_12h_translate(&_time);
 	}
 
-	// Read register 0x00..0x06
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 8))
+	if (sec)  *sec = _time.sec;
+	if (min)  *min = _time.min;
+	if (hour) *hour = _time.hour;
+
+	return (DS3231_OK);
+#else
+	uint8_t msgBuf[4];
+
+	// Read the registers 0x00..0x02
+	result = ds3231_read_regs(SECDR, msgBuf, 3);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	// Update stored time
-	_time.sec = bcd2dec(msgBuf[1]);
-	_time.min = bcd2dec(msgBuf[2]);
-	_time.hour = bcd2dec(msgBuf[3]);
-	_time.wday = bcd2dec(msgBuf[4]);
-	_time.mday = bcd2dec(msgBuf[5]);
-	_time.mon = bcd2dec(msgBuf[6]) & 0x1F;       // Month data is stored in Bit4..0
-	century = (msgBuf[6] & 0x80) >> 7;           // Century data is stored in Bit7
-	_time.year = (century == 1) ? 2000 + bcd2dec(msgBuf[7]) : 1900 + bcd2dec(msgBuf[7]);
+	if (sec)  *sec = bcd2dec(msgBuf[1]);
+	if (min)  *min = bcd2dec(msgBuf[2]);
+	if (hour) *hour = ds3231_hour_decode(msgBuf[3]);
+
+	return (DS3231_OK);
+#endif
+}
+
+uint8_t ds3231_get_date_s(uint8_t* mday, uint8_t* mon, uint8_t* year, uint8_t* hour, uint8_t* min, uint8_t* sec)
+{
+	struct time now;
+	uint8_t result;
 
-	// Deal with 12-hour mode
-	if(_time.hour == 0)
+#ifdef DS3231_TIME_CACHE
+	result = ds3231_cache_update();
+	if (result != DS3231_OK)
 	{
-		_time.twelveHour = 0;
-		_time.am = true;
+		// Handle transmission error
+		return (result);
 	}
-	else if(_time.hour < 12)
+	now = _time;
+#else
+	// Read seconds through year in one burst
+	result = ds3231_get_fields(&now, DS3231_F_TIME | DS3231_F_DATE);
+	if (result != DS3231_OK)
 	{
-		_time.twelveHour = _time.hour;
-		_time.am = true;
+		// Handle transmission error
+		return (result);
 	}
-	else
+#endif
+
+	if (hour12)
 	{
-		_time.twelveHour = _time.hour - 12;
-		_time.am = false;
+		ds3231_12h_translate(&now);
 	}
 
-	*time_ = _time;
+	// The caller's time belongs to the previous day if it is later than the time read now
+	if (hour && min && sec &&
+	    (now.hour < *hour ||
+	     (now.hour == *hour && (now.min < *min ||
+	                            (now.min == *min && now.sec < *sec)))))
+	{
+		*hour = now.hour;
+		*min = now.min;
+		*sec = now.sec;
+	}
 
-	return (true);
+	if (mday) *mday = now.mday;
+	if (mon)  *mon = now.mon;
+	if (year) *year = now.year;
+
+	return (DS3231_OK);
 }
 
-uint8_t ds3231_get_time_s(uint8_t* hour, uint8_t* min, uint8_t* sec)
+void ds3231_12h_translate(struct time* time_)
 {
-	uint8_t msgBuf[4];
+	time_->hour = time_->twelveHour + (time_->am ? 0 : 12);
+}
 
-	// Write the address of the first register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = SECDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+void ds3231_24h_to_12h(struct time* time_)
+{
+	time_->am = (time_->hour < 12);
+	time_->twelveHour = time_->am ? time_->hour : time_->hour - 12;
+}
+
+uint8_t ds3231_set_12h_mode(bool enable)
+{
+	uint8_t msgBuf[1 + A2HDR + 1];
+	uint8_t* regs = &msgBuf[1];
+	uint8_t result;
+
+	// Read the registers 0x00..0x0C
+	result = ds3231_read_regs(SECDR, msgBuf, A2HDR + 1);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	// Read the registers 0x00..0x02
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 4))
+	// The hour (and date) could roll over between the read and the write
+	if (regs[SECDR] == 0x59 && regs[SECDR + 1] == 0x59)
+	{
+
+		return (DS3231_ERR_ROLLOVER);
+	}
+
+	// Convert the hours registers, keeping the alarm mask bits
+	regs[HRSDR] = ds3231_hour_encode(ds3231_hour_decode(regs[HRSDR]), enable);
+	regs[A1HDR] = (regs[A1HDR] & 0x80) | ds3231_hour_encode(ds3231_hour_decode(regs[A1HDR] & 0x7F), enable);
+	regs[A2HDR] = (regs[A2HDR] & 0x80) | ds3231_hour_encode(ds3231_hour_decode(regs[A2HDR] & 0x7F), enable);
+
+	// Write the registers 0x02..0x0C back in one burst, placing the header over the seconds and minutes
+	regs[HRSDR - 2] = WRITE_ADD;
+	regs[HRSDR - 1] = HRSDR;
+#ifdef DS3231_TIME_CACHE
+	cacheValid = false;
+#endif
+	result = ds3231_write_regs(&regs[HRSDR - 2], 2 + A2HDR - HRSDR + 1);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	if (sec)  *sec = bcd2dec(msgBuf[1]);
-	if (min)  *min = bcd2dec(msgBuf[2]);
-	if (hour) *hour = bcd2dec(msgBuf[3]);
+	hour12 = enable;
+	hourModeKnown = true;
 
-	return (true);
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_set_time(struct time* time_)
 {
 	uint8_t msgBuf[9];
+	uint8_t result;
 	uint8_t century;
+	uint8_t year;
 
-	if (time_->year > 2000)
+#ifdef PARAM_VERIFICATION
+	if (!cal_is_valid(time_))
+	{
+
+		return (DS3231_ERR_PARAM);
+	}
+#endif
+	time_->wday = cal_weekday(time_);
+
+	result = ds3231_hour_mode();
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+
+	if (time_->year >= 100)
 	{
 		century = 0x80;
-		time_->year = time_->year - 2000;
+		year = time_->year - 100;
 	}
 	else
 	{
 		century = 0x00;
-		time_->year = time_->year - 1900;
+		year = time_->year;
 	}
 
 	msgBuf[0] = WRITE_ADD;
 	msgBuf[1] = SECDR;
 	msgBuf[2] = dec2bcd(time_->sec);
 	msgBuf[3] = dec2bcd(time_->min);
-	msgBuf[4] = dec2bcd(time_->hour);
+	msgBuf[4] = ds3231_hour_encode(time_->hour, hour12);
 	msgBuf[5] = dec2bcd(time_->wday);
 	msgBuf[6] = dec2bcd(time_->mday);
 	msgBuf[7] = dec2bcd(time_->mon) + century;
-	msgBuf[8] = dec2bcd(time_->year);
+	msgBuf[8] = dec2bcd(year);
 
-	if (TWI_start_transceiver_with_data(msgBuf, 9))
+#ifdef DS3231_TIME_CACHE
+	cacheValid = false;
+#endif
+	result = ds3231_write_regs(msgBuf, 9);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	return (true);
+	if (oscStopped)
+	{
+		// Read the "Status" register
+		result = ds3231_read_regs(STSDR, msgBuf, 1);
+		if (result != DS3231_OK)
+		{
+			// Handle transmission error
+			return (result);
+		}
+
+		// Clear the oscillator stop flag, leaving the alarm flags unchanged
+		msgBuf[0] = WRITE_ADD;
+		msgBuf[2] = msgBuf[1] & ~DS3231_STS_OSF;
+		msgBuf[1] = STSDR;
+		result = ds3231_write_regs(msgBuf, 3);
+		if (result != DS3231_OK)
+		{
+			// Handle transmission error
+			return (result);
+		}
+
+		oscStopped = false;
+	}
+
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_set_time_s(uint8_t hour, uint8_t min, uint8_t sec)
 {
 	uint8_t msgBuf[5];
+	uint8_t result;
+
+#ifdef PARAM_VERIFICATION
+	if (hour > 23 || min > 59 || sec > 59)
+	{
+
+		return (DS3231_ERR_PARAM);
+	}
+#endif
+	result = ds3231_hour_mode();
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
 
 	msgBuf[0] = WRITE_ADD;
 	msgBuf[1] = SECDR;
 	msgBuf[2] = dec2bcd(sec);
 	msgBuf[3] = dec2bcd(min);
-	msgBuf[4] = dec2bcd(hour);
+	msgBuf[4] = ds3231_hour_encode(hour, hour12);
 
-	if (TWI_start_transceiver_with_data(msgBuf, 5))
+#ifdef DS3231_TIME_CACHE
+	cacheValid = false;
+#endif
+	result = ds3231_write_regs(msgBuf, 5);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	return (true);
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_get_temp_int(int8_t* i, uint8_t* f)
 {
 	uint8_t msgBuf[3];
+	uint8_t result;
 
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = TMPDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
-	{
-		// Handle transmission error
-		return (false);
-	}
-
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 3))
+	// Read the "Temperature" registers
+	result = ds3231_read_regs(TMPDR, msgBuf, 2);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
 	*i = msgBuf[1];
 	*f = (msgBuf[2] >> 6);
 
-	return (true);
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_force_temp_conversion(uint8_t block)
 {
-	// TODO
-
-	return (true);
+	return ds3231_run(block ? scriptConvertBlock : scriptConvert, 0);
 }
 
 uint8_t ds3231_SQW_enable(bool enable)
 {
-	uint8_t msgBuf[3];
+	return ds3231_run(enable ? scriptSQWOn : scriptSQWOff, 0);
+}
 
-	// Write the address of the "Control" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = CTRDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
-	{
-		// Handle transmission error
-		return (false);
-	}
+uint8_t ds3231_osc32kHz_enable(bool enable)
+{
+	return ds3231_run(enable ? script32kHzOn : script32kHzOff, 0);
+}
 
-	// Read the "Control" register
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
-	{
-		// Handle transmission error
-		return (false);
-	}
+uint8_t ds3231_reset_alarm(uint8_t alarm)
+{
+	return ds3231_run((alarm == ALARM_1) ? scriptResetAlarm1 : scriptResetAlarm2, 0);
+}
 
-	if (enable)
-	{
-		msgBuf[1] |= 0x40;                       // Enable battery-backed square-wave oscillator
-		msgBuf[1] &= 0xFB;                       // Disable alarm interrupts
-	}
-	else
+uint8_t ds3231_clear_alarm(uint8_t alarm)
+{
+#ifdef PARAM_VERIFICATION
+	if (alarm > 1)
 	{
-		msgBuf[1] &= 0xBF;                       // Disable batter-backed square=wave oscillator
-	}
 
-	// Write the new settings to the "Control" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[2] = msgBuf[1];
-	msgBuf[1] = CTRDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 3))
-	{
-		// Handle transmission error
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
+#endif
 
-	return (true);
+	return ds3231_run(scriptClearFlags, 1 << alarm);
 }
 
-uint8_t ds3231_osc32kHz_enable(bool enable)
+/**Encodes an alarm into its registers.
+ *
+ * @param[out]    regs       Alarm registers, starting with seconds (ALARM_1) or minutes (ALARM_2).
+ */
+static void ds3231_alarm_encode(uint8_t* regs, uint8_t alarm, uint8_t mode, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
 {
-	uint8_t msgBuf[3];
+	uint8_t bits = pgm_read_byte(&alarmBits[mode]);
 
-	// Write the address of the "Status" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = STSDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	if (alarm == ALARM_1)
 	{
-		// Handle transmission error
-		return (false);
+		*(regs++) = dec2bcd(sec) | ((bits & 0x01) << 7);
 	}
+	regs[0] = dec2bcd(min)  | ((bits & 0x02) << 6);
+	regs[1] = ds3231_hour_encode(hour, hour12) | ((bits & 0x04) << 5);
+	regs[2] = dec2bcd(day)  | ((bits & 0x08) << 4)
+	                        | ((bits & 0x10) << 2);
+}
+
+/**Decodes the registers of an alarm.
+ *
+ * @param[in]     regs       Alarm registers, starting with seconds (ALARM_1) or minutes (ALARM_2).
+ */
+static void ds3231_alarm_decode(const uint8_t* regs, uint8_t alarm, uint8_t* day, uint8_t* hour, uint8_t* min, uint8_t* sec, uint8_t* mode)
+{
+	uint8_t bits = 0;
 
-	// Read the "Status" register
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	*sec = 0;
+	if (alarm == ALARM_1)
 	{
-		// Handle transmission error
-		return (false);
+		*sec = bcd2dec(regs[0] & 0x7F);
+		bits = regs[0] >> 7;
+		regs++;
 	}
+	*min = bcd2dec(regs[0] & 0x7F);
+	*hour = ds3231_hour_decode(regs[1] & 0x7F);
+	*day = bcd2dec(regs[2] & ((regs[2] & 0x40) ? 0x0F : 0x3F));
 
-	if (enable)
+	// Collect the mask bits as in DS3231_ALARM_BITS, then pick the mode by the first matched field
+	bits |= ((regs[0] & 0x80) >> 6) | ((regs[1] & 0x80) >> 5) | ((regs[2] & 0x80) >> 4) | ((regs[2] & 0x40) >> 2);
+	if (!(bits & 0x08))
 	{
-		msgBuf[1] |= 0x08;                       // Enable 32 kHz oscillator
+		*mode = (bits & 0x10) ? ALARM_WDAY_M : ALARM_MDAY_M;
 	}
-	else
+	else if (!(bits & 0x04))
 	{
-		msgBuf[1] &= 0xF7;                       // Disable 32 kHz oscillator
+		*mode = ALARM_HOUR_M;
 	}
-
-	// Write the new settings to the "Status" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[2] = msgBuf[1];
-	msgBuf[1] = STSDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 3))
+	else if (!(bits & 0x02))
 	{
-		// Handle transmission error
-		return (false);
+		*mode = ALARM_MIN_M;
 	}
-
-	return (true);
-}
-
-uint8_t ds3231_reset_alarm(uint8_t alarm)
-{
-	uint8_t msgBuf[(alarm == ALARM_1) ? 6 : 5];
-
-	msgBuf[0] = WRITE_ADD;
-	if (alarm == ALARM_1)
+	else if (alarm == ALARM_2)
 	{
-		msgBuf[1] = AL1DR;
-		msgBuf[2] = 0x00;
-		msgBuf[3] = 0x00;
-		msgBuf[4] = 0x00;
-		msgBuf[5] = 0x00;
+		*mode = ALARM_MIN;
 	}
 	else
 	{
-		msgBuf[1] = AL2DR;
-		msgBuf[2] = 0x00;
-		msgBuf[3] = 0x00;
-		msgBuf[4] = 0x00;
+		*mode = (bits & 0x01) ? ALARM_SEC : ALARM_SEC_M;
 	}
+}
 
-	if (TWI_start_transceiver_with_data(msgBuf, (alarm == ALARM_1) ? 6 : 5))
+/**Copies decoded alarm fields into a time struct.
+ *
+ */
+static void ds3231_alarm_to_time(struct time* time_, uint8_t mode, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
+{
+	time_->sec = sec;
+	time_->min = min;
+	time_->hour = hour;
+	ds3231_24h_to_12h(time_);
+	if (mode == ALARM_WDAY_M)
 	{
-		// Handle transmission error
-		return (false);
+		time_->wday = day;
+	}
+	else
+	{
+		time_->mday = day;
 	}
-
-	return (true);
 }
 
 uint8_t ds3231_set_alarm(struct time* time_, uint8_t alarm, uint8_t mode, bool intrpt)
 {
-	// TODO
-
-	return (true);
+	return ds3231_set_alarm_s((mode == ALARM_WDAY_M) ? time_->wday : time_->mday,
+	                          time_->hour, time_->min, time_->sec, alarm, mode, intrpt);
 }
 
 uint8_t ds3231_set_alarm_s(uint8_t day, uint8_t hour, uint8_t min, uint8_t sec, uint8_t alarm, uint8_t mode, bool intrpt)
@@ -401,110 +1443,99 @@ uint8_t ds3231_set_alarm_s(uint8_t day, uint8_t hour, uint8_t min, uint8_t sec,
 	if (mode == ALARM_WDAY_M && day > 7)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 	if (mode == ALARM_MDAY_M && day > 31)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 	if (hour > 23)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 	if (min > 59)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 	if (sec > 59)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 	if (alarm > 1)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
-	if (intrpt > 1)
+	if (mode > ALARM_MIN)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 #endif
-	uint8_t msgBuf[(alarm == ALARM_1) ? 6 : 5];
-
-	// Write the address of the "Control" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = CTRDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	// The alarm registers are followed by the "Control" register, so both are written in one burst
+	uint8_t first = (alarm == ALARM_1) ? AL1DR : AL2DR;
+	uint8_t count = CTRDR - first + 1;
+	uint8_t msgBuf[2 + CTRDR - AL1DR + 1];
+	uint8_t result;
+
+	result = ds3231_hour_mode();
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	// Read the "Control" register
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	// Read the "Control" register (and alarm 2, which lies in between for alarm 1)
+	result = ds3231_read_regs(first, &msgBuf[1], count);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	if (intrpt == true)
+	ds3231_alarm_encode(&msgBuf[2], alarm, mode, day, hour, min, sec);
+	if (intrpt)
 	{
-		msgBuf[1] |= 1 << alarm;                 // Enable interrupt
+		msgBuf[1 + count] |= (1 << alarm) | DS3231_CTR_INTCN;
 	}
 	else
 	{
-		msgBuf[1] &= ~(1 << alarm);              // Disable interrupt
+		msgBuf[1 + count] &= ~(1 << alarm);
 	}
 
-	// Write the new settings to the "Control" register
 	msgBuf[0] = WRITE_ADD;
-	msgBuf[2] = msgBuf[1];
-	msgBuf[1] = CTRDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 3))
+	msgBuf[1] = first;
+	result = ds3231_write_regs(msgBuf, 2 + count);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
-	}
-
-	// Write the alarm time
-	msgBuf[0] = WRITE_ADD;
-	if (alarm == ALARM_1)
-	{
-		msgBuf[1] = AL1DR;
-		msgBuf[2] = dec2bcd(sec)	| ((mode == ALARM_SEC)		? 0x80 : 0x00);
-		msgBuf[3] = dec2bcd(min)	| ((mode <= ALARM_SEC_M)	? 0x80 : 0x00);
-		msgBuf[4] = dec2bcd(hour)	| ((mode <= ALARM_MIN_M)	? 0x80 : 0x00);
-		msgBuf[5] = dec2bcd(day)	| ((mode <= ALARM_HOUR_M)	? 0x80 : 0x00)
-									| ((mode == ALARM_WDAY_M)	? 0x40 : 0x00);
-	}
-	else
-	{
-		msgBuf[1] = AL2DR;
-		msgBuf[2] = dec2bcd(min)	| ((mode == ALARM_MIN)		? 0x80 : 0x00);
-		msgBuf[3] = dec2bcd(hour)	| ((mode <= ALARM_MIN_M)	? 0x80 : 0x00);
-		msgBuf[4] = dec2bcd(day)	| ((mode <= ALARM_HOUR_M)	? 0x80 : 0x00)
-									| ((mode == ALARM_WDAY_M)	? 0x40 : 0x00);
-	}
-	if (TWI_start_transceiver_with_data(msgBuf, (alarm == ALARM_1) ? 6 : 5))
-	{
-		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	return (true);
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_get_alarm(struct time* time_, uint8_t alarm, uint8_t* mode, bool* intrpt)
 {
-	// TODO
+	uint8_t day;
+	uint8_t hour;
+	uint8_t min;
+	uint8_t sec;
+	uint8_t result;
+
+	result = ds3231_get_alarm_s(&day, &hour, &min, &sec, alarm, mode, intrpt);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
 
-	return (true);
+	ds3231_alarm_to_time(time_, *mode, day, hour, min, sec);
+
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_get_alarm_s(uint8_t* day, uint8_t* hour, uint8_t* min, uint8_t* sec, uint8_t alarm, uint8_t* mode, bool* intrpt)
@@ -513,98 +1544,53 @@ uint8_t ds3231_get_alarm_s(uint8_t* day, uint8_t* hour, uint8_t* min, uint8_t* s
 	if (alarm > 1)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 #endif
-	uint8_t msgBuf[(alarm == ALARM_1) ? 5 : 4];
-
-	// Write the "Control" register address
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = CTRDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
-	{
-		// Handle transmission error
-		return (false);
-	}
-
-	// Read the "Control" register
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	uint8_t first = (alarm == ALARM_1) ? AL1DR : AL2DR;
+	uint8_t count = CTRDR - first + 1;
+	uint8_t msgBuf[1 + CTRDR - AL1DR + 1];
+	uint8_t result;
+
+	// Read the registers of the selected alarm and the "Control" register
+	result = ds3231_read_regs(first, msgBuf, count);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	*intrpt = (msgBuf[1] & ~(1 << alarm));       // Get the "Alarm Enabled" bit
+	ds3231_alarm_decode(&msgBuf[1], alarm, day, hour, min, sec, mode);
+	*intrpt = (msgBuf[count] & (1 << alarm)) != 0;   // Get the "Alarm Interrupt Enable" bit
 
-	// Write the address of the first register of the selected alarm
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[1] = (alarm == ALARM_1) ? AL1DR : AL2DR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
-	{
-		// Handle transmission error
-		return (false);
-	}
+	return (DS3231_OK);
+}
 
-	// Read the registers of the selected alarm
-	msgBuf[0] = READ_ADD;
-	if (TWI_start_transceiver_with_data(msgBuf, (alarm == ALARM_1) ? 5 : 4))
+uint8_t ds3231_get_alarms(struct time alarms[2], uint8_t modes[2], bool intrpts[2])
+{
+	uint8_t msgBuf[1 + CTRDR - AL1DR + 1];
+	uint8_t day;
+	uint8_t hour;
+	uint8_t min;
+	uint8_t sec;
+	uint8_t result;
+
+	// Read both alarms and the "Control" register
+	result = ds3231_read_regs(AL1DR, msgBuf, CTRDR - AL1DR + 1);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
-	if (alarm == ALARM_1)
-	{
-		*sec = bcd2dec(msgBuf[1] & 0x7F);
-		*min = bcd2dec(msgBuf[2] & 0x7F);
-		*hour = bcd2dec(msgBuf[3] & 0x7F);
-		*day = bcd2dec(msgBuf[4] & (((msgBuf[4] & 0x40) == 0) ? 0x3F : 0x0F));
-		if ((msgBuf[4] & 0x80) == 0)
-		{
-			*mode = ((msgBuf[4] & 0x40) == 0) ? ALARM_MDAY_M : ALARM_WDAY_M;
-		}
-		else if ((msgBuf[3] & 0x80) == 0)
-		{
-			*mode = ALARM_HOUR_M;
-		}
-		else if ((msgBuf[2] & 0x80) == 0)
-		{
-			*mode = ALARM_MIN_M;
-		}
-		else if ((msgBuf[1] & 0x80) == 0)
-		{
-			*mode = ALARM_SEC_M;
-		}
-		else
-		{
-			*mode = ALARM_SEC;
-		}
-	}
-	else
-	{
-		*min = bcd2dec(msgBuf[1] & 0x7F);
-		*hour = bcd2dec(msgBuf[2] & 0x7F);
-		*day = bcd2dec(msgBuf[3] & (((msgBuf[3] & 0x40) == 0) ? 0x3F : 0x0F));
-		if ((msgBuf[3] & 0x80) == 0)
-		{
-			*mode = ((msgBuf[3] & 0x40) == 0) ? ALARM_MDAY_M : ALARM_WDAY_M;
-		}
-		else if ((msgBuf[2] & 0x80) == 0)
-		{
-			*mode = ALARM_HOUR_M;
-		}
-		else if ((msgBuf[1] & 0x80) == 0)
-		{
-			*mode = ALARM_MIN_M;
-		}
-		else
-		{
-			*mode = ALARM_MIN;
-		}
-	}
+	ds3231_alarm_decode(&msgBuf[1], ALARM_1, &day, &hour, &min, &sec, &modes[ALARM_1]);
+	ds3231_alarm_to_time(&alarms[ALARM_1], modes[ALARM_1], day, hour, min, sec);
+	ds3231_alarm_decode(&msgBuf[1 + AL2DR - AL1DR], ALARM_2, &day, &hour, &min, &sec, &modes[ALARM_2]);
+	ds3231_alarm_to_time(&alarms[ALARM_2], modes[ALARM_2], day, hour, min, sec);
+	intrpts[ALARM_1] = (msgBuf[1 + CTRDR - AL1DR] & DS3231_CTR_A1IE) != 0;
+	intrpts[ALARM_2] = (msgBuf[1 + CTRDR - AL1DR] & DS3231_CTR_A2IE) != 0;
 
-	return (true);
+	return (DS3231_OK);
 }
 
 uint8_t ds3231_check_alarm(bool* active, uint8_t alarm)
@@ -613,21 +1599,21 @@ uint8_t ds3231_check_alarm(bool* active, uint8_t alarm)
 	if (alarm > 1)
 	{
 
-		return (false);
+		return (DS3231_ERR_PARAM);
 	}
 #endif
 	uint8_t msgBuf[2];
+	uint8_t result;
 
-	// Write the address of the "Status" register
-	msgBuf[0] = WRITE_ADD;
-	msgBuf[0] = STSDR;
-	if (TWI_start_transceiver_with_data(msgBuf, 2))
+	// Read the "Status" register, bypassing a batch: its copy does not hold the alarm flags
+	result = ds3231_bus_read_regs(STSDR, msgBuf, 1);
+	if (result != DS3231_OK)
 	{
 		// Handle transmission error
-		return (false);
+		return (result);
 	}
 
 	*active = (msgBuf[1] & (1 << alarm));
 
-	return (true);
+	return (DS3231_OK);
 }
\ No newline at end of file
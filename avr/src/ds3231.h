@@ -26,9 +26,81 @@ SOFTWARE.
  *
  */
 
+#ifndef DS3231_H_
+#define DS3231_H_
+
 #include <avr/io.h>
 #include <stdbool.h>
 
+#include "twi.h"
+
+// Compile-time device configuration
+#ifndef DS3231_ADDRESS
+	#define DS3231_ADDRESS 0x68                  //!< 7-bit slave address of DS3231; may be overridden when compiling.
+#endif
+//#define DS3231_TIME_CACHE                      //!< Serve time reads from _time until the next SQW edge or tick limit.
+//#define DS3231_REG_CACHE                       //!< Keep a copy of the "Control" register instead of reading it before each change; only if no other master writes it.
+//#define DS3231_BATCH                           //!< Provide ds3231_begin_update() and ds3231_commit() to merge configuration changes into one write.
+#ifndef DS3231_CACHE_TICKS
+	#define DS3231_CACHE_TICKS 100               //!< Number of ds3231_cache_tick() calls after which the cached time expires.
+#endif
+
+#ifndef DS3231_RETRIES
+	#define DS3231_RETRIES 2                     //!< Number of retries after a transient error (address NACK or bus error); at most 16.
+#endif
+#ifndef DS3231_RETRY_DELAY_US
+	#define DS3231_RETRY_DELAY_US 100            //!< Delay before the first retry in us; doubled before each further retry.
+#endif
+#ifndef DS3231_POLL_LIMIT
+	#define DS3231_POLL_LIMIT 250                //!< Reads of a busy flag before giving up with DS3231_ERR_TIMEOUT.
+#endif
+#ifndef DS3231_POLL_DELAY_US
+	#define DS3231_POLL_DELAY_US 1000            //!< Delay between two reads of a busy flag in us; with DS3231_POLL_LIMIT, longer than a conversion (200 ms).
+#endif
+
+// Result codes returned by the ds3231_* functions
+#define DS3231_OK        0x00                    //!< Operation completed successfully.
+#define DS3231_ERR_PARAM 0x01                    //!< A parameter is out of range.
+#define DS3231_ERR_BUSY  0x02                    //!< The bus is in use by another transmission (e.g. called from an interrupt handler).
+#define DS3231_ERR_NACK  0x03                    //!< The DS3231 did not acknowledge its address (transient, retried).
+#define DS3231_ERR_BUS   0x04                    //!< Bus error: collision, unexpected or missing Start/Stop Condition (transient, retried).
+#define DS3231_ERR_DATA  0x05                    //!< The DS3231 did not acknowledge data (hard fault).
+#define DS3231_ERR_FAULT 0x06                    //!< Invalid transmission buffer (hard fault).
+#define DS3231_TIME_INVALID 0x07                 //!< The oscillator has stopped since the time was set; the time must be set again.
+#define DS3231_ERR_TIMEOUT 0x08                  //!< A busy flag of the DS3231 did not clear within DS3231_POLL_LIMIT reads (hard fault).
+#define DS3231_ERR_ROLLOVER 0x09                 //!< Refused in the last second of an hour, which could roll over before the write (transient, retry after the next second).
+
+// "Control" register bits
+#define DS3231_CTR_EOSC  0x80                    //!< Disable the oscillator on battery power (active low).
+#define DS3231_CTR_BBSQW 0x40                    //!< Battery-backed square-wave enable.
+#define DS3231_CTR_CONV  0x20                    //!< Convert temperature.
+#define DS3231_CTR_INTCN 0x04                    //!< Interrupt control (alarm interrupts instead of square wave).
+#define DS3231_CTR_A2IE  0x02                    //!< Alarm 2 interrupt enable.
+#define DS3231_CTR_A1IE  0x01                    //!< Alarm 1 interrupt enable.
+
+// "Status" register bits
+#define DS3231_STS_OSF     0x80                  //!< Oscillator stop flag.
+#define DS3231_STS_EN32KHZ 0x08                  //!< Enable 32.768 kHz output.
+#define DS3231_STS_BSY     0x04                  //!< Busy.
+#define DS3231_STS_A2F     0x02                  //!< Alarm 2 flag.
+#define DS3231_STS_A1F     0x01                  //!< Alarm 1 flag.
+
+// Used to select fields for ds3231_get_fields, in register order
+#define DS3231_F_SEC  0x01                       //!< Seconds.
+#define DS3231_F_MIN  0x02                       //!< Minutes.
+#define DS3231_F_HOUR 0x04                       //!< Hours (also updates the 12-hour fields).
+#define DS3231_F_WDAY 0x08                       //!< Day of the week.
+#define DS3231_F_MDAY 0x10                       //!< Date.
+#define DS3231_F_MON  0x20                       //!< Month.
+#define DS3231_F_YEAR 0x40                       //!< Year.
+#define DS3231_F_TIME (DS3231_F_SEC | DS3231_F_MIN | DS3231_F_HOUR)   //!< Seconds, minutes and hours.
+#define DS3231_F_DATE (DS3231_F_MDAY | DS3231_F_MON | DS3231_F_YEAR)  //!< Date, month and year.
+#define DS3231_F_ALL  0x7F                       //!< All timekeeping fields.
+
+#ifndef DS3231_BURST_GAP
+	#define DS3231_BURST_GAP 3                   //!< Maximum number of unrequested registers read to merge two bursts.
+#endif
+
 // Used to determine which alarm to work with
 #define ALARM_1      0                           //!< Select alarm 1.
 #define ALARM_2      1                           //!< Select alarm 2.
@@ -42,11 +114,28 @@ SOFTWARE.
 #define ALARM_WDAY_M 5                           //!< Alarm when day, hours, minutes and seconds match.
 #define ALARM_MIN    6                           //!< Alarm once a minute (at 00 seconds) (ALARM_2 only).
 
+/**Encodes an alarm mode into the alarm register mask bits.
+ *
+ * Bit0..3 are the A1M1..A1M4 (A2M2..A2M4 in Bit1..3) mask bits of the seconds,
+ * minutes, hours and day registers, Bit4 is the DY/DT bit of the day register.
+ * Evaluates to a constant when mode is a constant.
+ */
+#define DS3231_ALARM_BITS(mode) \
+	(((mode) == ALARM_SEC)    ? 0x0F : \
+	 ((mode) == ALARM_SEC_M)  ? 0x0E : \
+	 ((mode) == ALARM_MIN_M)  ? 0x0C : \
+	 ((mode) == ALARM_HOUR_M) ? 0x08 : \
+	 ((mode) == ALARM_MDAY_M) ? 0x00 : \
+	 ((mode) == ALARM_WDAY_M) ? 0x10 : 0x0E)
+
 /**Time structure.
  *
  * Time is stored and in both 24-hour and 12-hour modes,
  * and is updated when ds3231_get_time is called.
  *
+ * When the DS3231 is in 12-hour mode (see ds3231_set_12h_mode()), ds3231_get_time()
+ * only fills twelveHour and am; call ds3231_12h_translate() when hour is needed.
+ *
  * When setting time and alarms, 24-hour time is used.
  *
  * If you run your clock in 12-hour mode:
@@ -65,36 +154,140 @@ struct time {
 	uint8_t hour;                                //!< Hours [0;23].
 	uint8_t mday;                                //!< Date [0;31].
 	uint8_t mon;                                 //!< Month [1;12].
-	uint8_t year;                                //!< Year [1900;2099].
-	uint8_t wday;                                //!< Day of the week [1;7].
+	uint8_t year;                                //!< Years since 1900 [0;199].
+	uint8_t wday;                                //!< Day of the week [1;7], 1 being Sunday.
 
 	bool am;                                     //!< AM/PM (true/false) indicator.
 	uint8_t twelveHour;                          //!< Twelve hour time [0;11].
 };
 
 extern struct time _time;                        //!< Time stored at the last update.
+extern struct TWI_device ds3231_device;          //!< Bus handle of the DS3231: its address and, with TWI_STATISTICS, its bus usage counters.
+
+/**Brings the DS3231 into the given configuration, skipping all writes on a warm boot.
+ *
+ * Reads the "Control" and "Status" registers in one burst. If they already hold the
+ * given configuration nothing is written; otherwise both are written in one burst
+ * (alarm flags are left untouched). The oscillator stop flag is cleared by the next
+ * ds3231_set_time() call. The "Hours" register is read to learn whether the DS3231
+ * is in 12-hour mode, which later writes of the time and alarms keep.
+ *
+ * @param[in]     controlValue Expected "Control" register value (DS3231_CTR_* bits; CONV is ignored).
+ * @param[in]     statusValue  Expected "Status" register value (only DS3231_STS_EN32KHZ is used).
+ *
+ * @return                   Returns DS3231_OK if the time is valid, DS3231_TIME_INVALID if the oscillator
+ *                           has stopped since the time was set, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_init(uint8_t controlValue, uint8_t statusValue);
 
 /**Gets the current time from the DS3231.
+ *
+ * When DS3231_TIME_CACHE is defined, the time stored at the last update is
+ * returned until the cache is invalidated (see ds3231_cache_invalidate()).
  *
  * @param[out]    time_      Time struct to which to copy the time.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_get_time(struct time* time_);
+/**Gets selected fields of the current time from the DS3231.
+ *
+ * The selected registers are read in the fewest bursts, reading over short gaps of
+ * unselected registers where that is cheaper than starting a new transaction.
+ * Only the selected fields of time_ are written.
+ *
+ * @param[out]    time_      Time struct to which to copy the selected fields.
+ * @param[in]     fields     Fields to read (a combination of DS3231_F_* values).
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_get_fields(struct time* time_, uint8_t fields);
 /**Gets the current time from the DS3231.
+ *
+ * When DS3231_TIME_CACHE is defined, this is served from the same cache as ds3231_get_time().
  *
  * @param[out]    hour       The byte to which to copy the current hour from DS3231.
  * @param[out]    min        The byte to which to copy the current minute from DS3231.
  * @param[out]    sec        The byte to which to copy the current second from DS3231.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_get_time_s(uint8_t* hour, uint8_t* min, uint8_t* sec);
+/**Gets the current date from the DS3231, consistent with an earlier ds3231_get_time_s() call.
+ *
+ * Seconds through year are read in one burst, which the DS3231 latches at START.
+ * If the time read with the date is earlier than the time passed in, midnight passed
+ * between the two calls, and hour, min and sec are replaced with the time read with
+ * the date so that the caller is left with a consistent timestamp without a re-read.
+ * Use ds3231_get_time() when both are needed at once.
+ *
+ * @param[out]    mday       The byte to which to copy the current date.
+ * @param[out]    mon        The byte to which to copy the current month.
+ * @param[out]    year       The byte to which to copy the current year (years since 1900).
+ * @param[in,out] hour       The hour gotten by ds3231_get_time_s(), or NULL to skip the check.
+ * @param[in,out] min        The minute gotten by ds3231_get_time_s(), or NULL to skip the check.
+ * @param[in,out] sec        The second gotten by ds3231_get_time_s(), or NULL to skip the check.
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_get_date_s(uint8_t* mday, uint8_t* mon, uint8_t* year, uint8_t* hour, uint8_t* min, uint8_t* sec);
+/**Invalidates the cached time.
+ *
+ * Call from the 1 Hz SQW edge interrupt so that the next time read refreshes the cache.
+ * Only available when DS3231_TIME_CACHE is defined.
+ */
+void ds3231_cache_invalidate(void);
+/**Counts a local tick towards expiry of the cached time.
+ *
+ * The cache is invalidated after DS3231_CACHE_TICKS ticks; use this when the SQW output is not wired.
+ * Only available when DS3231_TIME_CACHE is defined.
+ */
+void ds3231_cache_tick(void);
+/**Gets the cache hit and miss counters.
+ *
+ * Only available when DS3231_TIME_CACHE is defined.
+ *
+ * @param[out]    hits       Number of time reads served from the cache.
+ * @param[out]    misses     Number of time reads that required a bus transaction.
+ */
+void ds3231_get_cache_stats(uint16_t* hits, uint16_t* misses);
+
+/**Sets hour from the 12-hour fields of a time.
+ *
+ * @param[in,out] time_      Time struct with twelveHour and am set.
+ */
+void ds3231_12h_translate(struct time* time_);
+/**Sets the 12-hour fields from hour of a time.
+ *
+ * @param[in,out] time_      Time struct with hour set.
+ */
+void ds3231_24h_to_12h(struct time* time_);
+/**Switches the hours registers of the time and both alarms to 12-hour or 24-hour mode.
+ *
+ * The registers are converted in one read and one write burst. Later writes of the
+ * time and alarms keep the selected mode.
+ *
+ * The time is read and its hours written back in a separate transmission, so in the
+ * last second of an hour (mm:ss = 59:59) the DS3231 could advance the hour, and the
+ * date, in between. The function then changes nothing and returns DS3231_ERR_ROLLOVER
+ * instead of blocking; the call succeeds once the second has passed.
+ *
+ * @param[in]     enable     Whether to use 12-hour mode.
+ *
+ * @return                   Returns DS3231_OK on success, DS3231_ERR_ROLLOVER during the last second
+ *                           of an hour, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_set_12h_mode(bool enable);
+
 /**Sets the time of the DS3231.
+ *
+ * The day of the week is calculated from the date and stored in time_->wday.
+ * With PARAM_VERIFICATION defined, invalid dates are rejected with DS3231_ERR_PARAM.
+ * If ds3231_init() found the oscillator stop flag set, it is cleared after the time is set.
  *
  * @param[in]     time_      Time struct from which to copy the time.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_set_time(struct time* time_);
 /**Sets the time of the DS3231.
@@ -103,7 +296,7 @@ uint8_t ds3231_set_time(struct time* time_);
  * @param[in]    min         The minute to set the DS3231 to.
  * @param[in]    sec         The second to set the DS3231 to.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_set_time_s(uint8_t hour, uint8_t min, uint8_t sec);
 
@@ -112,14 +305,17 @@ uint8_t ds3231_set_time_s(uint8_t hour, uint8_t min, uint8_t sec);
  * @param[out]   i           The integer part of the temperature.
  * @param[out]   f           The fraction part of the temperature (f/4).
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_get_temp_int(int8_t* i, uint8_t* f);
-/**
+/**Forces a temperature conversion.
+ *
+ * Waits until the DS3231 is not busy with an automatic conversion before starting.
  *
- * @param[in]    block
+ * @param[in]    block       Whether or not to wait until the conversion is complete.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, DS3231_ERR_TIMEOUT if the DS3231 stayed busy
+ *                           for DS3231_POLL_LIMIT reads, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_force_temp_conversion(uint8_t block);
 
@@ -127,14 +323,14 @@ uint8_t ds3231_force_temp_conversion(uint8_t block);
  *
  * @param[in]    enable      The state to which to set the square wave generator.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_SQW_enable(bool enable);
 /**Controls the 32 kHz square wave output.
  *
  * @param[in]    enable      The state to which to set the 32 kHz generator.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_osc32kHz_enable(bool enable);
 
@@ -142,17 +338,26 @@ uint8_t ds3231_osc32kHz_enable(bool enable);
  *
  * @param[in]    alarm       Which alarm to reset (ALARM_1 or ALARM_2).
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_reset_alarm(uint8_t alarm);
+/**Clears the alarm flag, releasing the INT pin if no other alarm flag is set.
+ *
+ * @param[in]    alarm       Which alarm flag to clear (ALARM_1 or ALARM_2).
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_clear_alarm(uint8_t alarm);
 /**Sets the alarm.
+ *
+ * The day is taken from wday in ALARM_WDAY_M mode, otherwise from mday.
  *
  * @param[in]    time_       The time to which to set the alarm to.
  * @param[in]    alarm       The alarm to set.
  * @param[in]    mode        The resolution to which to set the alarm to.
  * @param[in]    intrpt      Whether or not the alarm should generate an interrupt.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_set_alarm(struct time* time_, uint8_t alarm, uint8_t mode, bool intrpt);
 /**Sets the alarm.
@@ -164,18 +369,22 @@ uint8_t ds3231_set_alarm(struct time* time_, uint8_t alarm, uint8_t mode, bool i
  * @param[in]    alarm       The alarm to set.
  * @param[in]    mode        The resolution to which to set the alarm to.
  * @param[in]    intrpt      Whether or not the alarm should generate an interrupt.
+ *                           Enabling the interrupt also disables the 1 Hz square wave output.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_set_alarm_s(uint8_t day, uint8_t hour, uint8_t min, uint8_t sec, uint8_t alarm, uint8_t mode, bool intrpt);
 /**Gets the alarm.
+ *
+ * Sets sec, min, hour, the 12-hour fields, and wday (ALARM_WDAY_M mode) or mday;
+ * other fields are left unchanged.
  *
  * @param[out]   time_       The time of the alarm.
  * @param[in]    alarm       The alarm to get.
  * @param[out]   mode        The resolution of the alarm.
  * @param[out]   intrpt      Whether or not this alarm will generate an interrupt.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_get_alarm(struct time* time_, uint8_t alarm, uint8_t* mode, bool* intrpt);
 /**Gets the alarm.
@@ -188,14 +397,45 @@ uint8_t ds3231_get_alarm(struct time* time_, uint8_t alarm, uint8_t* mode, bool*
  * @param[out]   mode        The resolution of the alarm.
  * @param[out]   intrpt      Whether or not this alarm will generate an interrupt.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
  */
 uint8_t ds3231_get_alarm_s(uint8_t* day, uint8_t* hour, uint8_t* min, uint8_t* sec, uint8_t alarm, uint8_t* mode, bool* intrpt);
+/**Gets both alarms, reading them together with the "Control" register in one burst.
+ *
+ * @param[out]   alarms      The times of the alarms, indexed by ALARM_1 and ALARM_2 (see ds3231_get_alarm()).
+ * @param[out]   modes       The resolutions of the alarms.
+ * @param[out]   intrpts     Whether or not each alarm will generate an interrupt.
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_get_alarms(struct time alarms[2], uint8_t modes[2], bool intrpts[2]);
 /**Checks whether the alarm has been activated.
  *
  * @param[out]   active      Whether or not the alarm has been activated.
  * @param[in]    alarm       Which alarm to check.
  *
- * @return                   Returns TRUE (1) if time was gotten successfully, otherwise FALSE (0).
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_check_alarm(bool* active, uint8_t alarm);
+
+/**Starts buffering changes of the alarm, "Control" and "Status" registers (0x07..0x0F).
+ *
+ * Until ds3231_commit(), the functions changing these registers edit a copy, which is
+ * read in one burst on first use, and reads of them are served from the copy. The copy
+ * does not hold the alarm flags: ds3231_check_alarm() reads them from the DS3231, and
+ * the commit clears only those cleared in the batch, so alarms raised meanwhile are
+ * kept. Transmissions that only partly cover these registers write the pending changes
+ * first. A conversion started by ds3231_force_temp_conversion() begins at the commit
+ * and is not waited for. Has no effect while a batch is open. Only available when DS3231_BATCH is defined.
  */
-uint8_t ds3231_check_alarm(bool* active, uint8_t alarm);
\ No newline at end of file
+void ds3231_begin_update(void);
+/**Writes the changes buffered since ds3231_begin_update() in one burst and ends the batch.
+ *
+ * The batch ends even if the write fails; the changes are then lost and should be repeated.
+ * Only available when DS3231_BATCH is defined.
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_commit(void);
+
+#endif /* DS3231_H_ */
\ No newline at end of file
@@ -0,0 +1,502 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231.hpp
+ * @brief Header-only C++ driver for the DS3231, built on constexpr register descriptors.
+ *
+ * Registers and bit fields are described by constexpr values, and the alarm, the
+ * alarm mode and the bus are template parameters, so the compiler folds the register
+ * addresses, the alarm mask bits and the flag masks into immediate operands instead
+ * of looking them up at run time (compare ds3231_alarm_encode() in ds3231.c). The
+ * driver has no state: it always writes the time in 24-hour mode, and decodes hours
+ * in either mode.
+ *
+ * Unlike the C driver, it does not retry failed transmissions, does not cache or
+ * batch registers, and does not verify parameters. Its result codes are those of
+ * the C driver (DS3231_OK, DS3231_ERR_*). Both drivers may be linked into the same
+ * program. avr/bench/bench_cpp.cpp compares the two.
+ */
+
+#ifndef DS3231_HPP_
+#define DS3231_HPP_
+
+extern "C" {
+#include "ds3231.h"
+#include "calendar.h"
+#include "twi.h"
+}
+
+namespace ds3231 {
+
+/**A bit field within a register.
+ *
+ */
+struct Field {
+	uint8_t reg;                                 //!< Register address.
+	uint8_t mask;                                //!< Bits of the field.
+};
+
+// Registers
+constexpr uint8_t SECONDS = 0x00;                //!< First time register.
+constexpr uint8_t HOURS   = 0x02;                //!< Hours, with the 12-hour mode bits.
+constexpr uint8_t ALARM1  = 0x07;                //!< First alarm 1 register (seconds).
+constexpr uint8_t ALARM2  = 0x0B;                //!< First alarm 2 register (minutes).
+constexpr uint8_t CONTROL = 0x0E;                //!< "Control" register.
+constexpr uint8_t STATUS  = 0x0F;                //!< "Status" register.
+constexpr uint8_t TEMP    = 0x11;                //!< Temperature, integer part.
+
+// Fields
+constexpr Field BBSQW   = { CONTROL, DS3231_CTR_BBSQW };
+constexpr Field INTCN   = { CONTROL, DS3231_CTR_INTCN };
+constexpr Field EN32KHZ = { STATUS,  DS3231_STS_EN32KHZ };
+constexpr Field OSF     = { STATUS,  DS3231_STS_OSF };
+
+/**Converts a decimal value [0;99] to BCD.
+ *
+ */
+constexpr uint8_t to_bcd(uint8_t d)
+{
+	return (((d / 10) << 4) | (d % 10));
+}
+
+/**Converts a BCD value to decimal.
+ *
+ */
+constexpr uint8_t from_bcd(uint8_t b)
+{
+	return ((b >> 4) * 10 + (b & 0x0F));
+}
+
+/**Decodes an hours register in either mode to an hour [0;23].
+ *
+ */
+constexpr uint8_t hour_decode(uint8_t reg)
+{
+	return ((reg & 0x40) ? from_bcd(reg & 0x1F) % 12 + ((reg & 0x20) ? 12 : 0) : from_bcd(reg & 0x3F));
+}
+
+/**Describes the registers of an alarm.
+ *
+ * @tparam        Alarm      ALARM_1 or ALARM_2.
+ */
+template <uint8_t Alarm>
+struct AlarmRegs {
+	static_assert(Alarm == ALARM_1 || Alarm == ALARM_2, "Alarm must be ALARM_1 or ALARM_2");
+
+	static constexpr uint8_t first  = (Alarm == ALARM_1) ? ALARM1 : ALARM2;  //!< First alarm register.
+	static constexpr uint8_t count  = CONTROL - first;                       //!< Number of registers up to "Control".
+	static constexpr uint8_t enable = 1 << Alarm;                            //!< AxIE bit in "Control".
+	static constexpr uint8_t flag   = 1 << Alarm;                            //!< AxF bit in "Status".
+};
+
+/**Describes the mask bits of an alarm mode.
+ *
+ * @tparam        Alarm      ALARM_1 or ALARM_2.
+ * @tparam        Mode       The alarm mode (ALARM_SEC..ALARM_MIN).
+ */
+template <uint8_t Alarm, uint8_t Mode>
+struct AlarmMode {
+	static_assert(Mode <= ALARM_MIN, "Unknown alarm mode");
+	static_assert(Alarm == ALARM_1 || (Mode != ALARM_SEC && Mode != ALARM_SEC_M), "ALARM_2 does not track seconds");
+	static_assert(Alarm == ALARM_2 || Mode != ALARM_MIN, "ALARM_MIN is an ALARM_2 mode");
+
+	static constexpr uint8_t bits = DS3231_ALARM_BITS(Mode);                 //!< Mask bits, as in DS3231_ALARM_BITS.
+	static constexpr uint8_t sec  = (bits & 0x01) << 7;                      //!< A1M1.
+	static constexpr uint8_t min  = (bits & 0x02) << 6;                      //!< AxM2.
+	static constexpr uint8_t hour = (bits & 0x04) << 5;                      //!< AxM3.
+	static constexpr uint8_t day  = ((bits & 0x08) << 4) | ((bits & 0x10) << 2);  //!< AxM4 and DY/DT.
+};
+
+/**Bus policy using the TWI master (twi.c, twi0.c or twi_i2cdev.c) directly.
+ *
+ */
+struct TwiBus {
+	/**Writes msg[1..size-1] to the slave addressed by msg[0].
+	 *
+	 */
+	static bool write(uint8_t* msg, uint8_t size)
+	{
+		return (TWI_start_transceiver_with_data(msg, size) != 0);
+	}
+
+	/**Writes msg[1..writeSize-1], then reads readSize bytes into msg[1..] after a repeated Start Condition.
+	 *
+	 */
+	static bool write_read(uint8_t* msg, uint8_t writeSize, uint8_t readSize)
+	{
+		return (TWI_write_read(msg, writeSize, readSize) != 0);
+	}
+
+	/**Maps the last failed transmission to a DS3231 result code.
+	 *
+	 */
+	static uint8_t result(void)
+	{
+		if (TWI_is_busy())
+		{
+			return (DS3231_ERR_BUSY);
+		}
+
+		switch (TWI_get_state_info())
+		{
+			case TWI_NO_ACK_ON_ADDRESS:
+				return (DS3231_ERR_NACK);
+			case TWI_NO_ACK_ON_DATA:
+				return (DS3231_ERR_DATA);
+			case TWI_UE_START_CON:
+			case TWI_UE_STOP_CON:
+			case TWI_UE_DATA_COL:
+			case TWI_MISSING_START_CON:
+			case TWI_MISSING_STOP_CON:
+				return (DS3231_ERR_BUS);
+			default:
+				return (DS3231_ERR_FAULT);
+		}
+	}
+};
+
+/**The DS3231 driver.
+ *
+ * @tparam        Bus        Bus policy, see TwiBus.
+ * @tparam        Address    7-bit slave address.
+ */
+template <class Bus = TwiBus, uint8_t Address = DS3231_ADDRESS>
+class DS3231 {
+public:
+	static constexpr uint8_t writeAdd = Address << 1;                        //!< Address byte with the write bit.
+
+	/**Reads consecutive registers.
+	 *
+	 * @param[in]     reg        First register.
+	 * @param[out]    regs       The register values.
+	 * @tparam        Count      Number of registers.
+	 */
+	template <uint8_t Count>
+	static uint8_t read(uint8_t reg, uint8_t* regs)
+	{
+		uint8_t msgBuf[Count + 1];
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = reg;
+		if (!Bus::write_read(msgBuf, 2, Count))
+		{
+			return (Bus::result());
+		}
+
+		for (uint8_t i = 0; i < Count; i++)
+		{
+			regs[i] = msgBuf[i + 1];
+		}
+
+		return (DS3231_OK);
+	}
+
+	/**Sets and clears the bits of a register in one read-modify-write.
+	 *
+	 * @param[in]     reg        The register.
+	 * @param[in]     set        Bits to set.
+	 * @param[in]     clear      Bits to clear; set takes precedence.
+	 */
+	static uint8_t update(uint8_t reg, uint8_t set, uint8_t clear)
+	{
+		uint8_t msgBuf[3];
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = reg;
+		if (!Bus::write_read(msgBuf, 2, 1))
+		{
+			return (Bus::result());
+		}
+
+		msgBuf[2] = (msgBuf[1] & ~clear) | set;
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = reg;
+		if (!Bus::write(msgBuf, 3))
+		{
+			return (Bus::result());
+		}
+
+		return (DS3231_OK);
+	}
+
+	/**Sets or clears a field.
+	 *
+	 */
+	static uint8_t set(Field field, bool enable)
+	{
+		return (enable ? update(field.reg, field.mask, 0) : update(field.reg, 0, field.mask));
+	}
+
+	/**Writes the "Control" and "Status" registers if they differ; see ds3231_init().
+	 *
+	 * @return                   Returns DS3231_TIME_INVALID if the oscillator has stopped, as ds3231_init().
+	 */
+	static uint8_t init(uint8_t controlValue, uint8_t statusValue)
+	{
+		uint8_t msgBuf[4];
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = CONTROL;
+		if (!Bus::write_read(msgBuf, 2, 2))
+		{
+			return (Bus::result());
+		}
+
+		bool oscStopped = (msgBuf[2] & OSF.mask) != 0;
+
+		controlValue &= ~DS3231_CTR_CONV;
+		statusValue = (msgBuf[2] & ~EN32KHZ.mask) | (statusValue & EN32KHZ.mask);
+		if ((msgBuf[1] & ~DS3231_CTR_CONV) != controlValue || msgBuf[2] != statusValue)
+		{
+			msgBuf[0] = writeAdd;
+			msgBuf[1] = CONTROL;
+			msgBuf[2] = controlValue;
+			msgBuf[3] = statusValue;             // Writing 1 to the flags leaves them unchanged
+			if (!Bus::write(msgBuf, 4))
+			{
+				return (Bus::result());
+			}
+		}
+
+		return (oscStopped ? DS3231_TIME_INVALID : DS3231_OK);
+	}
+
+	/**Gets the time and date; see ds3231_get_time().
+	 *
+	 * hour is set in either mode; the 12-hour fields are not.
+	 */
+	static uint8_t get_time(struct time* time_)
+	{
+		uint8_t regs[7];
+		uint8_t result = read<7>(SECONDS, regs);
+
+		if (result != DS3231_OK)
+		{
+			return (result);
+		}
+
+		time_->sec = from_bcd(regs[0]);
+		time_->min = from_bcd(regs[1]);
+		time_->hour = hour_decode(regs[2]);
+		time_->wday = from_bcd(regs[3]);
+		time_->mday = from_bcd(regs[4]);
+		time_->mon = from_bcd(regs[5] & 0x1F);
+		time_->year = from_bcd(regs[6]) + ((regs[5] & 0x80) ? 100 : 0);
+
+		return (DS3231_OK);
+	}
+
+	/**Gets the time; see ds3231_get_time_s().
+	 *
+	 */
+	static uint8_t get_time_s(uint8_t* hour, uint8_t* min, uint8_t* sec)
+	{
+		uint8_t regs[3];
+		uint8_t result = read<3>(SECONDS, regs);
+
+		if (result != DS3231_OK)
+		{
+			return (result);
+		}
+
+		*sec = from_bcd(regs[0]);
+		*min = from_bcd(regs[1]);
+		*hour = hour_decode(regs[2]);
+
+		return (DS3231_OK);
+	}
+
+	/**Sets the time and date in 24-hour mode; wday is calculated.
+	 *
+	 * Does not clear the oscillator stop flag; see clear_osf().
+	 */
+	static uint8_t set_time(struct time* time_)
+	{
+		uint8_t msgBuf[9];
+		bool century = time_->year >= 100;
+
+		time_->wday = cal_weekday(time_);
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = SECONDS;
+		msgBuf[2] = to_bcd(time_->sec);
+		msgBuf[3] = to_bcd(time_->min);
+		msgBuf[4] = to_bcd(time_->hour);
+		msgBuf[5] = to_bcd(time_->wday);
+		msgBuf[6] = to_bcd(time_->mday);
+		msgBuf[7] = to_bcd(time_->mon) | (century ? 0x80 : 0x00);
+		msgBuf[8] = to_bcd(century ? time_->year - 100 : time_->year);
+		if (!Bus::write(msgBuf, 9))
+		{
+			return (Bus::result());
+		}
+
+		return (DS3231_OK);
+	}
+
+	/**Sets the time in 24-hour mode; see ds3231_set_time_s().
+	 *
+	 */
+	static uint8_t set_time_s(uint8_t hour, uint8_t min, uint8_t sec)
+	{
+		uint8_t msgBuf[5];
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = SECONDS;
+		msgBuf[2] = to_bcd(sec);
+		msgBuf[3] = to_bcd(min);
+		msgBuf[4] = to_bcd(hour);
+		if (!Bus::write(msgBuf, 5))
+		{
+			return (Bus::result());
+		}
+
+		return (DS3231_OK);
+	}
+
+	/**Clears the oscillator stop flag, after the time has been set.
+	 *
+	 */
+	static uint8_t clear_osf(void)
+	{
+		return (set(OSF, false));
+	}
+
+	/**Gets the temperature; see ds3231_get_temp_int().
+	 *
+	 */
+	static uint8_t get_temp_int(int8_t* i, uint8_t* f)
+	{
+		uint8_t regs[2];
+		uint8_t result = read<2>(TEMP, regs);
+
+		if (result != DS3231_OK)
+		{
+			return (result);
+		}
+
+		*i = (int8_t)regs[0];
+		*f = (regs[1] >> 6) * 25;
+
+		return (DS3231_OK);
+	}
+
+	/**Enables or disables the battery-backed square wave; see ds3231_SQW_enable().
+	 *
+	 */
+	static uint8_t SQW_enable(bool enable)
+	{
+		return (enable ? update(CONTROL, BBSQW.mask, INTCN.mask) : update(CONTROL, 0, BBSQW.mask));
+	}
+
+	/**Enables or disables the 32.768 kHz output; see ds3231_osc32kHz_enable().
+	 *
+	 */
+	static uint8_t osc32kHz_enable(bool enable)
+	{
+		return (set(EN32KHZ, enable));
+	}
+
+	/**Sets an alarm in 24-hour mode; see ds3231_set_alarm_s().
+	 *
+	 * The registers from the alarm to "Control" (for ALARM_1 including those of alarm 2)
+	 * are read and written back in one burst each, as in the C driver.
+	 *
+	 * @tparam        Alarm      ALARM_1 or ALARM_2.
+	 * @tparam        Mode       The alarm mode; checked against the alarm at compile time.
+	 */
+	template <uint8_t Alarm, uint8_t Mode>
+	static uint8_t set_alarm(uint8_t day, uint8_t hour, uint8_t min, uint8_t sec, bool intrpt)
+	{
+		typedef AlarmRegs<Alarm> R;
+		typedef AlarmMode<Alarm, Mode> M;
+		uint8_t msgBuf[2 + R::count + 1];
+		uint8_t* regs = &msgBuf[2];
+		uint8_t result = read<R::count + 1>(R::first, regs);
+
+		if (result != DS3231_OK)
+		{
+			return (result);
+		}
+
+		if (intrpt)
+		{
+			regs[R::count] |= R::enable | INTCN.mask;
+		}
+		else
+		{
+			regs[R::count] &= ~R::enable;
+		}
+		if (Alarm == ALARM_1)
+		{
+			*(regs++) = to_bcd(sec) | M::sec;
+		}
+		regs[0] = to_bcd(min) | M::min;
+		regs[1] = to_bcd(hour) | M::hour;
+		regs[2] = to_bcd(day) | M::day;
+
+		msgBuf[0] = writeAdd;
+		msgBuf[1] = R::first;
+		if (!Bus::write(msgBuf, 2 + R::count + 1))
+		{
+			return (Bus::result());
+		}
+
+		return (DS3231_OK);
+	}
+
+	/**Checks the flag of an alarm; see ds3231_check_alarm().
+	 *
+	 * @tparam        Alarm      ALARM_1 or ALARM_2.
+	 */
+	template <uint8_t Alarm>
+	static uint8_t check_alarm(bool* active)
+	{
+		uint8_t status;
+		uint8_t result = read<1>(STATUS, &status);
+
+		if (result != DS3231_OK)
+		{
+			return (result);
+		}
+
+		*active = (status & AlarmRegs<Alarm>::flag) != 0;
+
+		return (DS3231_OK);
+	}
+
+	/**Clears the flag of an alarm; see ds3231_clear_alarm().
+	 *
+	 * @tparam        Alarm      ALARM_1 or ALARM_2.
+	 */
+	template <uint8_t Alarm>
+	static uint8_t clear_alarm(void)
+	{
+		return (update(STATUS, 0, AlarmRegs<Alarm>::flag));
+	}
+};
+
+}
+
+#endif /* DS3231_HPP_ */
\ No newline at end of file
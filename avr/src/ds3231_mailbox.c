@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_mailbox.c
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/cpufunc.h>
+#include "ds3231_mailbox.h"
+
+#define MAILBOX_MASK (DS3231_MAILBOX_SIZE - 1)  //!< Mask used to wrap the mailbox indices.
+
+static struct ds3231_request* volatile mailbox[DS3231_MAILBOX_SIZE];
+static volatile uint8_t mailboxHead;             //!< Next free slot; written by the producer only.
+static volatile uint8_t mailboxTail;             //!< Next pending slot; written by the consumer only.
+
+uint8_t ds3231_mailbox_post(struct ds3231_request* req)
+{
+	uint8_t head = mailboxHead;
+
+	if (((head + 1) & MAILBOX_MASK) == mailboxTail)
+	{
+		// Mailbox is full
+		return (DS3231_ERR_BUSY);
+	}
+
+	req->status = DS3231_REQ_PENDING;
+	_MemoryBarrier();                            // Keep the caller's type and arg stores before the publication
+	mailbox[head] = req;
+	mailboxHead = (head + 1) & MAILBOX_MASK;     // Publish only after the slot is filled
+
+	return (DS3231_OK);
+}
+
+void ds3231_mailbox_service(void)
+{
+	uint8_t tail = mailboxTail;
+	struct ds3231_request* req;
+	uint8_t result;
+
+	while (tail != mailboxHead)
+	{
+		req = mailbox[tail];
+
+		switch (req->type)
+		{
+			case DS3231_REQ_GET_TIME:
+				result = ds3231_get_time(&req->time);
+				break;
+			case DS3231_REQ_GET_TEMP:
+				result = ds3231_get_temp_int(&req->temp.i, &req->temp.f);
+				break;
+			case DS3231_REQ_CHECK_ALARM:
+				result = ds3231_check_alarm(&req->active, req->arg);
+				break;
+			default:
+				result = DS3231_ERR_PARAM;
+				break;
+		}
+
+		req->result = result;
+		_MemoryBarrier();                        // Keep the result stores before the status the producer polls
+		req->status = (result == DS3231_OK) ? DS3231_REQ_DONE : DS3231_REQ_FAILED;
+		tail = (tail + 1) & MAILBOX_MASK;
+		mailboxTail = tail;                      // Release the slot only after the result is stored
+	}
+}
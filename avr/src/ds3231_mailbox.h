@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_mailbox.h
+ * @brief Lock-free request mailbox for using the DS3231 from interrupt handlers.
+ *
+ * Interrupt handlers post requests with ds3231_mailbox_post() and the main loop
+ * performs them with ds3231_mailbox_service(), so no bus transaction ever runs
+ * in interrupt context. All interrupt handlers together form the single producer
+ * (AVR interrupts do not nest), the main loop is the single consumer.
+ */
+
+#ifndef DS3231_MAILBOX_H_
+#define DS3231_MAILBOX_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+#include "ds3231.h"
+
+#ifndef DS3231_MAILBOX_SIZE
+	#define DS3231_MAILBOX_SIZE 4                //!< Number of requests that can be pending; must be a power of two.
+#endif
+#if DS3231_MAILBOX_SIZE < 2 || DS3231_MAILBOX_SIZE > 256 || (DS3231_MAILBOX_SIZE & (DS3231_MAILBOX_SIZE - 1))
+	#error "DS3231_MAILBOX_SIZE must be a power of two within [2;256], the 8-bit indices are wrapped with a mask"
+#endif
+
+// Request types
+#define DS3231_REQ_GET_TIME    0                 //!< Read the time into time.
+#define DS3231_REQ_GET_TEMP    1                 //!< Read the temperature into temp.
+#define DS3231_REQ_CHECK_ALARM 2                 //!< Check the alarm selected by arg into active.
+
+// Request status
+#define DS3231_REQ_PENDING     0                 //!< Request has been posted and not yet performed.
+#define DS3231_REQ_DONE        1                 //!< Request was performed successfully.
+#define DS3231_REQ_FAILED      2                 //!< Request was performed, but failed (see result).
+
+/**A request to the DS3231 and its result.
+ *
+ * The request must stay allocated until status is no longer DS3231_REQ_PENDING.
+ */
+struct ds3231_request {
+	uint8_t type;                                //!< Request type (DS3231_REQ_*).
+	uint8_t arg;                                 //!< Request argument (alarm for DS3231_REQ_CHECK_ALARM).
+	volatile uint8_t status;                     //!< Request status, set by the main loop.
+	uint8_t result;                              //!< Result code of the performed request (DS3231_OK or DS3231_ERR_*).
+
+	union
+	{
+		struct time time;                        //!< Result of DS3231_REQ_GET_TIME.
+		struct
+		{
+			int8_t i;                            //!< Integer part of the temperature.
+			uint8_t f;                           //!< Fraction part of the temperature (f/4).
+		} temp;                                  //!< Result of DS3231_REQ_GET_TEMP.
+		bool active;                             //!< Result of DS3231_REQ_CHECK_ALARM.
+	};
+};
+
+/**Posts a request to the mailbox. Call from interrupt handlers only.
+ *
+ * @param[in,out] req        The request to post; status is set to DS3231_REQ_PENDING.
+ *
+ * @return                   Returns DS3231_OK if the request was posted, DS3231_ERR_BUSY if the mailbox is full.
+ */
+uint8_t ds3231_mailbox_post(struct ds3231_request* req);
+/**Performs all pending requests. Call from the main loop only.
+ *
+ */
+void ds3231_mailbox_service(void);
+
+#endif /* DS3231_MAILBOX_H_ */
\ No newline at end of file
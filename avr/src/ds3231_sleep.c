@@ -0,0 +1,165 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_sleep.c
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "ds3231_sleep.h"
+#include "calendar.h"
+
+static struct ds3231_task* schedTasks;           //!< Scheduled tasks.
+static uint8_t schedCount;                       //!< Number of scheduled tasks.
+
+/**Wakes the MCU from power-down.
+ *
+ * The wake source is disabled, as INT stays low until the alarm flag is cleared.
+ */
+ISR(DS3231_WAKE_vect)
+{
+	DS3231_WAKE_DISABLE();
+}
+
+/**Reads the time as seconds since 2000-01-01 00:00:00.
+ *
+ */
+static uint8_t ds3231_sleep_now(uint32_t* now)
+{
+	struct time time_;
+	uint8_t result;
+
+#ifdef DS3231_TIME_CACHE
+	ds3231_cache_invalidate();                   // The cache tick source does not run during power-down
+#endif
+	result = ds3231_get_time(&time_);
+	if (result != DS3231_OK)
+	{
+		// Handle transmission error
+		return (result);
+	}
+
+	ds3231_12h_translate(&time_);                // Hour is not decoded in 12-hour mode
+	*now = cal_to_epoch(&time_);
+
+	return (DS3231_OK);
+}
+
+uint8_t ds3231_sleep_init(struct ds3231_task* tasks, uint8_t count)
+{
+	uint32_t now;
+	uint8_t result;
+	uint8_t i;
+
+	result = ds3231_sleep_now(&now);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		tasks[i].due = now + tasks[i].interval;
+	}
+	schedTasks = tasks;
+	schedCount = count;
+
+	DS3231_WAKE_DISABLE();
+	DS3231_INT_PULLUP();                         // INT is open drain
+
+	return (DS3231_OK);
+}
+
+uint8_t ds3231_sleep_run(void)
+{
+	struct time alarm;
+	uint32_t now;
+	uint32_t next;
+	uint8_t result;
+	uint8_t i;
+
+	result = ds3231_sleep_now(&now);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
+
+	// Run the due tasks; periods missed while busy are skipped
+	next = UINT32_MAX;
+	for (i = 0; i < schedCount; i++)
+	{
+		struct ds3231_task* task = &schedTasks[i];
+
+		if (task->due <= now)
+		{
+			task->run();
+			task->due += ((now - task->due) / task->interval + 1) * task->interval;
+		}
+		if (task->due < next)
+		{
+			next = task->due;
+		}
+	}
+
+	// Intervals are below a day, so matching hours, minutes and seconds is unambiguous
+	cal_from_epoch(next, &alarm);
+	result = ds3231_set_alarm_s(0, alarm.hour, alarm.min, alarm.sec, ALARM_1, ALARM_HOUR_M, true);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
+	result = ds3231_clear_alarm(ALARM_1);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
+
+	// The alarm does not fire if its time passed while it was being armed
+	result = ds3231_sleep_now(&now);
+	if (result != DS3231_OK)
+	{
+		return (result);
+	}
+	if (now >= next)
+	{
+		return (DS3231_OK);
+	}
+
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	DS3231_WAKE_ENABLE();
+	if (DS3231_INT_HIGH())
+	{
+		sleep_enable();
+		sei();                                   // The instruction after sei is executed before any interrupt
+		sleep_cpu();
+		sleep_disable();
+	}
+	DS3231_WAKE_DISABLE();
+	sei();
+
+	return (DS3231_OK);
+}
@@ -0,0 +1,120 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_sleep.h
+ * @brief Alarm-driven power-down scheduler.
+ *
+ * Runs periodic tasks and sleeps in SLEEP_MODE_PWR_DOWN between them. Alarm 1 is
+ * armed for the next due task, and the MCU is woken by the DS3231 INT pin, so no
+ * time is spent awake polling ds3231_check_alarm(). Alarm 1 and its interrupt are
+ * reserved for the scheduler.
+ *
+ *     static struct ds3231_task tasks[] = { { measure, 60 }, { report, 3600 } };
+ *
+ *     ds3231_sleep_init(tasks, 2);
+ *     while (1)
+ *     {
+ *         ds3231_sleep_run();
+ *     }
+ */
+
+#ifndef DS3231_SLEEP_H_
+#define DS3231_SLEEP_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+
+#include "ds3231.h"
+
+// Wake source; define all five to use a different pin or device
+#ifndef DS3231_WAKE_vect
+	#if defined(__AVR_ATtiny25__) | defined(__AVR_ATtiny45__) | defined(__AVR_ATtiny85__)
+		// INT0 shares its pin with the USI clock, so a pin change interrupt on PB3 is used
+		#define DS3231_WAKE_vect      PCINT0_vect
+		#define DS3231_WAKE_ENABLE()  (PCMSK |= (1 << PCINT3), GIMSK |= (1 << PCIE))
+		#define DS3231_WAKE_DISABLE() (GIMSK &= ~(1 << PCIE))
+		#define DS3231_INT_HIGH()     (PINB & (1 << PINB3))
+		#define DS3231_INT_PULLUP()   (PORTB |= (1 << PINB3))
+	#elif defined(__AVR_AT90Tiny26__) | defined(__AVR_ATtiny26__)
+		// INT0 on PB6 in its reset default low level mode, which wakes from power-down
+		#define DS3231_WAKE_vect      INT0_vect
+		#define DS3231_WAKE_ENABLE()  (GIMSK |= (1 << INT0))
+		#define DS3231_WAKE_DISABLE() (GIMSK &= ~(1 << INT0))
+		#define DS3231_INT_HIGH()     (PINB & (1 << PINB6))
+		#define DS3231_INT_PULLUP()   (PORTB |= (1 << PINB6))
+	#elif defined(__AVR_AT90Tiny2313__) | defined(__AVR_ATtiny2313__)
+		// INT0 on PD2, low level
+		#define DS3231_WAKE_vect      INT0_vect
+		#define DS3231_WAKE_ENABLE()  (GIMSK |= (1 << INT0))
+		#define DS3231_WAKE_DISABLE() (GIMSK &= ~(1 << INT0))
+		#define DS3231_INT_HIGH()     (PIND & (1 << PIND2))
+		#define DS3231_INT_PULLUP()   (PORTD |= (1 << PIND2))
+	#elif defined(__AVR_AT90Mega169__) | defined(__AVR_ATmega169PA__) | \
+		defined(__AVR_AT90Mega165__) | defined(__AVR_ATmega165__)   | \
+		defined(__AVR_ATmega325__)   | defined(__AVR_ATmega3250__)  | \
+		defined(__AVR_ATmega645__)   | defined(__AVR_ATmega6450__)  | \
+		defined(__AVR_ATmega329__)   | defined(__AVR_ATmega3290__)  | \
+		defined(__AVR_ATmega649__)   | defined(__AVR_ATmega6490__)  | \
+		defined(__AVR_ATmega169P__)
+		// INT0 on PD1, low level
+		#define DS3231_WAKE_vect      INT0_vect
+		#define DS3231_WAKE_ENABLE()  (EIMSK |= (1 << INT0))
+		#define DS3231_WAKE_DISABLE() (EIMSK &= ~(1 << INT0))
+		#define DS3231_INT_HIGH()     (PIND & (1 << PIND1))
+		#define DS3231_INT_PULLUP()   (PORTD |= (1 << PIND1))
+	#else
+		// TWI0 devices wake through a pin interrupt of their PORT, which depends on the board
+		#error "No default DS3231 wake-up pin for this device; define DS3231_WAKE_vect, DS3231_WAKE_ENABLE(), DS3231_WAKE_DISABLE(), DS3231_INT_HIGH() and DS3231_INT_PULLUP()"
+	#endif
+#endif
+
+/**A periodic task.
+ *
+ */
+struct ds3231_task {
+	void (*run)(void);                           //!< Function to run when the task is due.
+	uint16_t interval;                           //!< Period in seconds [1;65535].
+	uint32_t due;                                //!< Next due time in seconds since 2000-01-01 00:00:00, set by the scheduler.
+};
+
+/**Schedules the tasks, each first due one interval from now.
+ *
+ * The INT pin needs a pull-up (the internal one is enabled).
+ *
+ * @param[in,out] tasks      Array of tasks; must stay allocated while the scheduler runs.
+ * @param[in]     count      Number of tasks [1;255].
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_sleep_init(struct ds3231_task* tasks, uint8_t count);
+/**Runs the due tasks, arms alarm 1 for the next one and sleeps until it fires.
+ *
+ * Call repeatedly from the main loop. Interrupts are enabled on return. Other
+ * interrupts also wake the MCU; the call then returns early.
+ *
+ * @return                   Returns DS3231_OK on success, otherwise a DS3231_ERR_* code.
+ */
+uint8_t ds3231_sleep_run(void);
+
+#endif /* DS3231_SLEEP_H_ */
@@ -29,12 +29,58 @@ SOFTWARE.
 #include <avr/io.h>
 #include <compat/twi.h>
 #include <stdbool.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
 #include "twi.h"
 
+#ifndef TWI_BACKEND_TWI0
+
 uint8_t TWI_master_stop(void);
 uint8_t TWI_master_transfer(uint8_t temp);
+static uint8_t TWI_master_transceive(uint8_t *msg, uint8_t msgSize, bool stop);
+
+#ifdef TWI_STATISTICS
+	#define TWI_STAT_INC(counter) (TWI_stats.counter++)
+#else
+	#define TWI_STAT_INC(counter)
+#endif
+
+#ifdef TWI_UNROLLED
+	#ifdef TWI_FAST_MODE
+		#define TWI_LOW_NS    1300               //!< Minimum SCL low period in ns.
+		#define TWI_HIGH_NS   600                //!< Minimum SCL high period in ns.
+		#define TWI_PERIOD_NS 2500               //!< Minimum SCL period (400 kHz) in ns.
+	#else
+		#define TWI_LOW_NS    4700
+		#define TWI_HIGH_NS   4000
+		#define TWI_PERIOD_NS 10000
+	#endif
+
+	#define TWI_CYCLES(ns) ((F_CPU / 1000UL * (ns) + 999999UL) / 1000000UL)   //!< CPU cycles covering ns, rounded up.
+	#define TWI_MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+	// The low period is stretched so that the whole period meets the SCL frequency limit
+	#define TWI_LOW_CYCLES  TWI_MAX(TWI_CYCLES(TWI_LOW_NS), TWI_CYCLES(TWI_PERIOD_NS) - TWI_CYCLES(TWI_HIGH_NS))
+	#define TWI_HIGH_CYCLES TWI_CYCLES(TWI_HIGH_NS)
+
+	// Cycles spent outside the delays: out USICR for the low period, sbis and out USICR for the high period
+	#define TWI_LOW_DELAY  TWI_MAX((long)TWI_LOW_CYCLES - 1, 0)
+	#define TWI_HIGH_DELAY TWI_MAX((long)TWI_HIGH_CYCLES - 3, 0)
+
+	/**Generates one SCL clock pulse, starting and ending with SCL low.
+	 *
+	 */
+	#define TWI_CLOCK_PULSE(clk) \
+		do \
+		{ \
+			__builtin_avr_delay_cycles(TWI_LOW_DELAY); \
+			USICR = (clk);                           /* Generate positive SCL edge */ \
+			while (!(PIN_TWI & (1 << PIN_TWI_SCL))); /* Wait for SCL to go HIGH */ \
+			__builtin_avr_delay_cycles(TWI_HIGH_DELAY); \
+			USICR = (clk);                           /* Generate negative SCL edge */ \
+		} while (0)
+#endif
 
 /**
  *
@@ -52,11 +98,40 @@ union TWI_state
 	};
 } TWI_state;
 
+static volatile bool TWI_busy;                   //!< Set while a transmission is in progress.
+
+#ifdef TWI_STATISTICS
+struct TWI_stats TWI_stats;
+
+void TWI_get_stats(struct TWI_stats* stats)
+{
+	*stats = TWI_stats;
+}
+
+void TWI_reset_stats(void)
+{
+	TWI_stats.transfers = 0;
+	TWI_stats.bytes = 0;
+	TWI_stats.errors = 0;
+}
+#endif
+
 uint8_t TWI_get_state_info(void)
 {
 	return TWI_state.errorState;
 }
 
+bool TWI_is_busy(void)
+{
+	return (TWI_busy);
+}
+
+bool TWI_bus_idle(void)
+{
+	// Both lines are released between a Stop and the next Start Condition
+	return ((PIN_TWI & ((1 << PIN_TWI_SDA) | (1 << PIN_TWI_SCL))) == ((1 << PIN_TWI_SDA) | (1 << PIN_TWI_SCL)));
+}
+
 void TWI_master_initialize(void)
 {
 	PORT_TWI |= (1 << PIN_TWI_SDA);              // Enable pullup on SDA, to set high as released state
@@ -77,6 +152,57 @@ void TWI_master_initialize(void)
 }
 
 uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
+{
+	bool busy;
+	uint8_t result;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)            // Claim the bus; interrupts are only held off for the test
+	{
+		busy = TWI_busy;
+		TWI_busy = true;
+	}
+	if (busy)
+	{
+		return (false);                          // Leave TWI_state to the transmission in progress
+	}
+
+	result = TWI_master_transceive(msg, msgSize, true);
+	TWI_busy = false;
+
+	return result;
+}
+
+uint8_t TWI_write_read(uint8_t *msg, uint8_t writeSize, uint8_t readSize)
+{
+	bool busy;
+	uint8_t result;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)            // Claim the bus; interrupts are only held off for the test
+	{
+		busy = TWI_busy;
+		TWI_busy = true;
+	}
+	if (busy)
+	{
+		return (false);                          // Leave TWI_state to the transmission in progress
+	}
+
+	result = TWI_master_transceive(msg, writeSize, false);
+	if (result)
+	{
+		msg[0] |= (1 << TWI_READ_BIT);           // The next transmission starts with a repeated Start Condition
+		result = TWI_master_transceive(msg, readSize + 1, true);
+	}
+	TWI_busy = false;
+
+	return result;
+}
+
+/**Performs a transmission on a claimed bus (see TWI_start_transceiver_with_data).
+ *
+ * Without stop the bus is kept with SCL low, for a repeated Start Condition.
+ */
+static uint8_t TWI_master_transceive(uint8_t *msg, uint8_t msgSize, bool stop)
 {
 	uint8_t tempUSISR_8bit = (1 << USISIF) |     // Prepare register value to:
 	                         (1 << USIOIF) |     // Clear flags, and set USI to
@@ -88,19 +214,23 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 	                         (1 << USIPF)  |     // shift 1 bit i.e. count 2 clock edges
 	                         (1 << USIDC)  |
 	                         (0xE << USICNT0);
+	uint8_t data;
 
 	TWI_state.errorState = 0;
 	TWI_state.addressMode = true;
+	TWI_STAT_INC(transfers);
 
 #ifdef PARAM_VERIFICATION
 	if (msg > (uint8_t*)RAMEND)                  // Test if address is outside SRAM space
 	{
 		TWI_state.errorState = TWI_DATA_OUT_OF_BOUND;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 	if (msgSize <= 1)                            // Test if the transmission buffer is empty
 	{
 		TWI_state.errorState = TWI_NO_DATA;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 #endif
@@ -109,16 +239,19 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 	if(USISR & (1 << USISIF))
 	{
 		TWI_state.errorState = TWI_UE_START_CON;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 	if(USISR & (1 << USIPF))
 	{
 		TWI_state.errorState = TWI_UE_STOP_CON;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 	if(USISR & (1 << USIDC))
 	{
 		TWI_state.errorState = TWI_UE_DATA_COL;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 #endif
@@ -130,6 +263,7 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 
 	                                             // Release SCL to ensure that (repeated) Start can be performed
 	PORT_TWI |= (1 << PIN_TWI_SCL);
+	DDR_TWI |= (1 << PIN_TWI_SDA);               // Enable SDA as output (released, USIDR holds 0xFF), after a lost arbitration
 	while (!(PIN_TWI & (1 << PIN_TWI_SCL)));
 #ifdef TWI_FAST_MODE
 	_delay_us(T4_TWI / 4);
@@ -147,7 +281,8 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 	if(!(USISR & (1 << USISIF)))
 	{
 		TWI_state.errorState = TWI_MISSING_START_CON;
-		return (true);
+		TWI_STAT_INC(errors);
+		return (false);
 	}
 #endif
 
@@ -158,8 +293,22 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 		{
 			                                     // Write a byte
 			PORT_TWI &= ~(1 << PIN_TWI_SCL);     // Pull SCL LOW
-			USIDR = *(msg++);                    // Setup data
-			TWI_master_transfer(tempUSISR_8bit); // Send 8 bits on the bus
+			data = *(msg++);
+			USIDR = data;                        // Setup data
+			TWI_STAT_INC(bytes);
+			                                     // Send 8 bits on the bus; the USI samples SDA while shifting,
+			                                     // so a different byte means another master drove SDA low
+			if (TWI_master_transfer(tempUSISR_8bit) != data)
+			{
+				                                 // Arbitration lost: leave the bus to the other master
+				DDR_TWI &= ~(1 << PIN_TWI_SDA);  // Enable SDA as input
+				PORT_TWI |= (1 << PIN_TWI_SCL) | (1 << PIN_TWI_SDA);  // Release SCL and SDA
+				USISR = (1 << USISIF) | (1 << USIOIF) |  // Clear the flags, so that the USI does not
+				        (1 << USIPF)  | (1 << USIDC);    // hold SCL low after the counter overflow
+				TWI_state.errorState = TWI_UE_DATA_COL;
+				TWI_STAT_INC(errors);
+				return (false);
+			}
 			                                     // Clock and verify (N)ACK from slave
 			DDR_TWI &= ~(1 << PIN_TWI_SDA);      // Enable SDA as input
 			if(TWI_master_transfer(tempUSISR_1bit) & (1 << TWI_NACK_BIT))
@@ -173,6 +322,7 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 					TWI_state.errorState = TWI_NO_ACK_ON_DATA;
 				}
 
+				TWI_STAT_INC(errors);
 				return (false);
 			}
 			TWI_state.addressMode = false;       // Perform address transmission only once
@@ -181,6 +331,7 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 		{
 			DDR_TWI &= ~(1 << PIN_TWI_SDA);	     // Enable SDA as input
 			*(msg++) = TWI_master_transfer(tempUSISR_8bit);
+			TWI_STAT_INC(bytes);
 			                                     // Prepare to generate (N)ACK
 			if (msgSize == 1)                    // If transmission of last byte was performed
 			{
@@ -194,11 +345,44 @@ uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
 		}
 	} while (--msgSize);                         // Until all data sent/received
 
-	TWI_master_stop();                           // Send a Stop Condition on the TWI bus
+	if (stop)
+	{
+		TWI_master_stop();                       // Send a Stop Condition on the TWI bus
+	}
 
 	return (true);                               // Transmission completed successfully
 }
 
+#ifdef TWI_UNROLLED
+uint8_t TWI_master_transfer(uint8_t temp)
+{
+	const uint8_t clk = (0 << USISIE) | (0 << USIOIE) |  // Disable interrupts
+	                    (1 << USIWM1) | (1 << USIWM0) |  // Set USI in two-wire mode
+	                    (1 << USICS1) | (0 << USICS0) |  // Set shift register clock source as external, positive edge
+	                    (1 << USICLK) |                  // Set 4-bit counter clock source as software clock strobe
+	                    (1 << USITC);                    // Toggle SCL, and strobe the counter
+
+	USISR = temp;                                // Set USISR according to temp
+
+	TWI_CLOCK_PULSE(clk);
+	if (!(temp & (0x0F << USICNT0)))             // 8 bits: the counter starts at 0 and needs 16 edges
+	{
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+		TWI_CLOCK_PULSE(clk);
+	}
+
+	temp = USIDR;                                // Read out data
+	USIDR = 0xFF;                                // Release SDA
+	DDR_TWI |= (1 << PIN_TWI_SDA);               // Enable SDA as output
+
+	return temp;
+}
+#else
 uint8_t TWI_master_transfer(uint8_t temp)
 {
 	USISR = temp;                                // Set USISR according to temp
@@ -207,7 +391,7 @@ uint8_t TWI_master_transfer(uint8_t temp)
 	        (1 << USIWM1) | (1 << USIWM0) |      // Set USI in two-wire mode
 	        (1 << USICS1) | (0 << USICS0) |      // Set shift register clock source as external, positive edge
 	        (1 << USICLK) |                      // Set 4-bit counter clock source as software clock strobe
-	        (0 << USITC);                        // Do nothing with Toggle Clock
+	        (1 << USITC);                        // Toggle SCL, and strobe the counter
 
 	do
 	{
@@ -225,6 +409,7 @@ uint8_t TWI_master_transfer(uint8_t temp)
 
 	return temp;
 }
+#endif
 
 uint8_t TWI_master_stop(void)
 {
@@ -239,9 +424,13 @@ uint8_t TWI_master_stop(void)
 	if(!(USISR & (1 << USIPF)))
 	{
 		TWI_state.errorState = TWI_MISSING_STOP_CON;
+		TWI_STAT_INC(errors);
 		return (false);
 	}
 #endif
+	USISR = (1 << USIPF);                        // Clear the Stop Condition flag, checked by the next transmission
 
 	return (true);
-}
\ No newline at end of file
+}
+
+#endif /* TWI_BACKEND_TWI0 */
\ No newline at end of file
@@ -29,6 +29,11 @@ SOFTWARE.
  *
  */
 
+#ifndef TWI_H_
+#define TWI_H_
+
+#include <stdbool.h>
+
 // Defines controlling timing limits
 #define TWI_FAST_MODE                            //!< Must be defined for clock speeds [100;400] kHz.
 
@@ -50,6 +55,18 @@ SOFTWARE.
 #define PARAM_VERIFICATION                       //!<
 #define NOISE_TESTING                            //!<
 #define SIGNAL_VERIFY                            //!<
+//#define TWI_STATISTICS                         //!< Count transmissions, bytes and errors (see TWI_get_stats).
+//#define TWI_UNROLLED                           //!< Unroll the USI bit loop, with SCL timing derived from F_CPU in cycles.
+
+#ifndef TWI_ARBITRATION_RETRIES
+	#define TWI_ARBITRATION_RETRIES 3            //!< Retries of a device transmission after arbitration is lost to another master.
+#endif
+#ifndef TWI_WRITE_READ_MAX
+	#define TWI_WRITE_READ_MAX 3                 //!< Largest number of bytes written by TWI_device_write_read(), including the address byte.
+#endif
+#ifndef TWI_IDLE_TIMEOUT_US
+	#define TWI_IDLE_TIMEOUT_US 1000             //!< Maximum time to wait for the bus to go idle before a retry, in microseconds.
+#endif
 
 // Bit and byte definitions
 #define TWI_READ_BIT 0                           //!< Bit position for R/W bit in "address byte"
@@ -88,7 +105,7 @@ SOFTWARE.
 
 	#define DDR_TWI     DDRB
 	#define PORT_TWI    PORTB
-	#define PIN_TWI     PINE
+	#define PIN_TWI     PINB
 	#define PIN_TWI_SDA PINB0
 	#define PIN_TWI_SCL PINB2
 #endif
@@ -97,24 +114,117 @@ SOFTWARE.
 
 	#define DDR_TWI     DDRB
 	#define PORT_TWI    PORTB
-	#define PIN_TWI     PINE
+	#define PIN_TWI     PINB
 	#define PIN_TWI_SDA PINB5
 	#define PIN_TWI_SCL PINB7
 #endif
 
-/**Sets the USI module in TWI mode, and the TWI bus in idle/released mode.
+#if defined(TWI0)                                // tinyAVR 0/1/2-series, megaAVR 0-series and AVR Dx devices
+
+	#define TWI_BACKEND_TWI0                     //!< Use the TWI0 peripheral (twi0.c) instead of the USI module (twi.c).
+#endif
+
+/**Bus usage counters, collected when TWI_STATISTICS is defined.
+ *
+ */
+struct TWI_stats {
+	uint16_t transfers;                          //!< Number of started transmissions.
+	uint16_t bytes;                              //!< Number of bytes sent or received, including address bytes.
+	uint16_t errors;                             //!< Number of failed transmissions.
+};
+
+/**A slave device on the bus, used with TWI_device_transceive().
+ *
+ */
+struct TWI_device {
+	uint8_t address;                             //!< 7-bit slave address.
+#ifdef TWI_STATISTICS
+	struct TWI_stats stats;                      //!< Transmissions to this device; retried transmissions are counted once.
+	uint16_t collisions;                         //!< Number of times arbitration was lost to another master.
+#endif
+};
+
+/**Sets the USI module (or the TWI0 peripheral) in TWI mode, and the TWI bus in idle/released mode.
  *
  */
 void TWI_master_initialize(void);
 /**Sends or receives a byte array of defined length.
  *
  * @param[in,out] msg        Transmission buffer. First location must contain slave address and R/W (1/0) bit.
+ * If called while another transmission is in progress (e.g. from an interrupt handler),
+ * returns 0 immediately without touching the bus or the error information (see TWI_is_busy()).
+ *
  * @param[in]     msgSize    Number of bytes in the transmission buffer.
  * @return                   Returns 1 if transmission was completed successfully, otherwise 0.
  */
 uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize);
+/**Writes bytes to a slave, then reads from it after a repeated Start Condition.
+ *
+ * Used to set a register pointer and read the registers from it, without another
+ * master getting the bus in between. Rejected like TWI_start_transceiver_with_data()
+ * while another transmission is in progress.
+ *
+ * @param[in,out] msg        Transmission buffer. First location must contain slave address and the write (0) bit,
+ *                           followed by the bytes to write; the bytes read are stored from the second location.
+ * @param[in]     writeSize  Number of bytes to write, including the address byte.
+ * @param[in]     readSize   Number of bytes to read; the buffer must hold readSize + 1 bytes.
+ * @return                   Returns 1 if transmission was completed successfully, otherwise 0.
+ */
+uint8_t TWI_write_read(uint8_t *msg, uint8_t writeSize, uint8_t readSize);
 /**Gets the error information about the last transmission
  *
  * @return                   Returns the error information about the last transmission.
  */
-uint8_t TWI_get_state_info(void);
\ No newline at end of file
+uint8_t TWI_get_state_info(void);
+/**Checks whether a transmission is in progress.
+ *
+ * After TWI_start_transceiver_with_data() failed, this tells a transmission rejected because
+ * the bus was in use (e.g. when called from an interrupt handler) from a failed one; the
+ * error information then still belongs to the transmission in progress.
+ *
+ * @return                   Returns true while a transmission is in progress.
+ */
+bool TWI_is_busy(void);
+/**Checks whether the bus is idle, i.e. no other master holds it.
+ *
+ * @return                   Returns true if the bus is idle.
+ */
+bool TWI_bus_idle(void);
+/**Sends or receives a byte array to or from a device.
+ *
+ * The address bits of msg[0] are filled in from the device; only the R/W bit has to be set.
+ * If arbitration is lost to another master (TWI_UE_DATA_COL), the transmission is retried
+ * up to TWI_ARBITRATION_RETRIES times, each time once the bus has gone idle.
+ *
+ * @param[in,out] device     The device to address.
+ * @param[in,out] msg        Transmission buffer, as for TWI_start_transceiver_with_data().
+ * @param[in]     msgSize    Number of bytes in the transmission buffer.
+ * @return                   Returns 1 if transmission was completed successfully, otherwise 0.
+ */
+uint8_t TWI_device_transceive(struct TWI_device* device, uint8_t* msg, uint8_t msgSize);
+/**Writes bytes to a device, then reads from it after a repeated Start Condition.
+ *
+ * The address bits of msg[0] are filled in from the device. Retried after a lost
+ * arbitration like TWI_device_transceive(), with the bytes to write restored.
+ *
+ * @param[in,out] device     The device to address.
+ * @param[in,out] msg        Transmission buffer, as for TWI_write_read().
+ * @param[in]     writeSize  Number of bytes to write, including the address byte; at most TWI_WRITE_READ_MAX.
+ * @param[in]     readSize   Number of bytes to read.
+ * @return                   Returns 1 if transmission was completed successfully, otherwise 0.
+ */
+uint8_t TWI_device_write_read(struct TWI_device* device, uint8_t* msg, uint8_t writeSize, uint8_t readSize);
+/**Gets the bus usage counters collected since the last reset.
+ *
+ * Only available when TWI_STATISTICS is defined.
+ *
+ * @param[out]    stats      Struct to which to copy the counters.
+ */
+void TWI_get_stats(struct TWI_stats* stats);
+/**Resets the bus usage counters.
+ *
+ * Only available when TWI_STATISTICS is defined.
+ */
+void TWI_reset_stats(void);
+
+#endif /* TWI_H_ */
\ No newline at end of file
@@ -0,0 +1,283 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file twi0.c
+ *
+ * TWI master using the TWI0 peripheral of the tinyAVR 0/1/2-series, megaAVR 0-series
+ * and AVR Dx devices. Transmissions are driven by the host interrupt; Smart Mode
+ * acknowledges received bytes when MDATA is read, so a burst read costs one data
+ * register read per byte. Global interrupts must be enabled while transmitting: with
+ * interrupts disabled a transmission fails at once with TWI_MISSING_START_CON, and one
+ * that does not end within TWI0_TIMEOUT_US (bus held by a slave) is aborted with
+ * TWI_UE_START_CON.
+ */
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdbool.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+#include "twi.h"
+
+#ifdef TWI_BACKEND_TWI0
+
+#ifdef TWI_FAST_MODE
+	#define TWI0_SCL_FREQ 400000UL               //!< SCL frequency in Hz.
+#else
+	#define TWI0_SCL_FREQ 100000UL               //!< SCL frequency in Hz.
+#endif
+
+#ifndef TWI0_TIMEOUT_US
+	#define TWI0_TIMEOUT_US 25000UL              //!< Time after which a transmission is aborted, in microseconds.
+#endif
+#if TWI0_TIMEOUT_US > 65535
+	#error "TWI0_TIMEOUT_US must fit the 16-bit wait count"
+#endif
+
+#ifndef TWI0_RISE_NS
+	#define TWI0_RISE_NS 0                       //!< SCL rise time in ns; 0 keeps SCL at or below TWI0_SCL_FREQ on any bus.
+#endif
+
+// SCL frequency = F_CPU / (10 + 2 * MBAUD + F_CPU * rise time), with F_CPU the peripheral clock (CLK_PER).
+// Both terms are rounded so that MBAUD is rounded up, which keeps SCL at or below TWI0_SCL_FREQ.
+#define TWI0_PERIOD_CYCLES ((F_CPU + TWI0_SCL_FREQ - 1) / TWI0_SCL_FREQ)   //!< CLK_PER cycles per SCL period.
+#define TWI0_RISE_CYCLES   (F_CPU / 1000UL * TWI0_RISE_NS / 1000000UL)      //!< CLK_PER cycles of the SCL rise time.
+
+#if TWI0_PERIOD_CYCLES <= 10 + TWI0_RISE_CYCLES
+	// F_CPU is too low for TWI0_SCL_FREQ (e.g. 3.33 MHz with TWI_FAST_MODE): run SCL at the highest
+	// frequency possible, F_CPU / (10 + rise time), which is below TWI0_SCL_FREQ
+	#define TWI0_BAUD 0                          //!< MBAUD value for TWI0_SCL_FREQ.
+#else
+	#define TWI0_BAUD ((TWI0_PERIOD_CYCLES - 10 - TWI0_RISE_CYCLES + 1) / 2)
+#endif
+
+#if TWI0_BAUD > 255
+	#error "F_CPU is too high for TWI0_SCL_FREQ, MBAUD is an 8-bit register"
+#endif
+
+#ifdef TWI_STATISTICS
+	#define TWI_STAT_INC(counter) (TWI_stats.counter++)
+#else
+	#define TWI_STAT_INC(counter)
+#endif
+
+static volatile uint8_t TWI_errorState;          //!< Error information about the last transmission.
+static volatile bool TWI_busy;                   //!< Set while a transmission is in progress.
+static volatile bool TWI_done;                   //!< Set by the interrupt handler when the transmission has ended.
+static volatile bool TWI_addressMode;            //!< Set until the slave has acknowledged its address.
+static uint8_t* volatile TWI_msg;                //!< Next byte to send or receive.
+static volatile uint8_t TWI_remaining;           //!< Number of bytes left to send or receive.
+static volatile uint8_t TWI_readSize;            //!< Number of bytes to read after a repeated Start Condition, 0 for none.
+static uint8_t* TWI_readMsg;                     //!< Transmission buffer of the read after a repeated Start Condition.
+
+#ifdef TWI_STATISTICS
+struct TWI_stats TWI_stats;
+
+void TWI_get_stats(struct TWI_stats* stats)
+{
+	*stats = TWI_stats;
+}
+
+void TWI_reset_stats(void)
+{
+	TWI_stats.transfers = 0;
+	TWI_stats.bytes = 0;
+	TWI_stats.errors = 0;
+}
+#endif
+
+uint8_t TWI_get_state_info(void)
+{
+	return TWI_errorState;
+}
+
+bool TWI_is_busy(void)
+{
+	return (TWI_busy);
+}
+
+bool TWI_bus_idle(void)
+{
+	return ((TWI0.MSTATUS & TWI_BUSSTATE_gm) == TWI_BUSSTATE_IDLE_gc);
+}
+
+void TWI_master_initialize(void)
+{
+	TWI0.MBAUD = TWI0_BAUD;
+	TWI0.MCTRLA = TWI_RIEN_bm | TWI_WIEN_bm |    // Enable read and write interrupts
+	              TWI_SMEN_bm |                  // Enable Smart Mode
+	              TWI_ENABLE_bm;                 // Enable master
+	TWI0.MSTATUS = TWI_BUSSTATE_IDLE_gc;         // Force the bus state to idle
+}
+
+/**Performs a transmission, followed by a read after a repeated Start Condition if readSize is not 0.
+ *
+ */
+static uint8_t TWI_transceive(uint8_t *msg, uint8_t msgSize, uint8_t readSize)
+{
+	bool busy;
+	uint16_t wait;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)            // Claim the bus; interrupts are only held off for the test
+	{
+		busy = TWI_busy;
+		TWI_busy = true;
+	}
+	if (busy)
+	{
+		return (false);                          // Leave the error information to the transmission in progress
+	}
+
+	TWI_errorState = 0;
+	TWI_STAT_INC(transfers);
+
+#ifdef PARAM_VERIFICATION
+	if (msgSize <= 1)                            // Test if the transmission buffer is empty
+	{
+		TWI_errorState = TWI_NO_DATA;
+		TWI_STAT_INC(errors);
+		TWI_busy = false;
+		return (false);
+	}
+#endif
+
+	if (!(SREG & (1 << SREG_I)))
+	{
+		TWI_errorState = TWI_MISSING_START_CON;  // The interrupt handler could not run the transmission
+		TWI_STAT_INC(errors);
+		TWI_busy = false;
+		return (false);
+	}
+
+	TWI_msg = msg + 1;
+	TWI_remaining = msgSize - 1;
+	TWI_readSize = readSize;
+	TWI_readMsg = msg;
+	TWI_addressMode = true;
+	TWI_done = false;
+
+	TWI0.MCTRLB = TWI_ACKACT_ACK_gc;             // Acknowledge received bytes until the last one
+	TWI0.MADDR = *msg;                           // Send a Start Condition and the address byte
+	TWI_STAT_INC(bytes);
+
+	for (wait = 0; !TWI_done && wait < TWI0_TIMEOUT_US; wait++)   // The interrupt handler performs the transmission
+	{
+		_delay_us(1);
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (!TWI_done)
+		{
+			// Bus hung: reset the master, so that the interrupt handler no longer touches msg
+			TWI0.MCTRLB = TWI_FLUSH_bm;
+			TWI0.MSTATUS = TWI_BUSSTATE_IDLE_gc;
+			TWI_errorState = TWI_UE_START_CON;
+			TWI_done = true;
+		}
+	}
+
+	TWI_busy = false;
+	if (TWI_errorState)
+	{
+		TWI_STAT_INC(errors);
+		return (false);
+	}
+
+	return (true);                               // Transmission completed successfully
+}
+
+uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
+{
+	return (TWI_transceive(msg, msgSize, 0));
+}
+
+uint8_t TWI_write_read(uint8_t *msg, uint8_t writeSize, uint8_t readSize)
+{
+	return (TWI_transceive(msg, writeSize, readSize));
+}
+
+/**Advances the transmission after each address or data byte.
+ *
+ */
+ISR(TWI0_TWIM_vect)
+{
+	uint8_t status = TWI0.MSTATUS;
+
+	if (status & (TWI_ARBLOST_bm | TWI_BUSERR_bm))
+	{
+		TWI_errorState = (status & TWI_ARBLOST_bm) ? TWI_UE_DATA_COL : TWI_UE_START_CON;
+		TWI0.MSTATUS = TWI_ARBLOST_bm | TWI_BUSERR_bm | TWI_RIF_bm | TWI_WIF_bm;
+		TWI_done = true;
+	}
+	else if (status & TWI_RIF_bm)                // A byte has been received
+	{
+		TWI_addressMode = false;
+		TWI_STAT_INC(bytes);
+		if (--TWI_remaining)
+		{
+			*TWI_msg++ = TWI0.MDATA;             // Smart Mode sends ACK and receives the next byte
+		}
+		else
+		{
+			TWI0.MCTRLB = TWI_ACKACT_NACK_gc |   // NACK the last byte and send a Stop Condition
+			              TWI_MCMD_STOP_gc;
+			*TWI_msg = TWI0.MDATA;
+			TWI_done = true;
+		}
+	}
+	else if (status & TWI_WIF_bm)                // The address or a data byte has been sent
+	{
+		if (status & TWI_RXACK_bm)
+		{
+			TWI_errorState = TWI_addressMode ? TWI_NO_ACK_ON_ADDRESS : TWI_NO_ACK_ON_DATA;
+			TWI0.MCTRLB = TWI_MCMD_STOP_gc;
+			TWI_done = true;
+		}
+		else if (TWI_remaining)
+		{
+			TWI_addressMode = false;
+			TWI_remaining--;
+			TWI0.MDATA = *TWI_msg++;
+			TWI_STAT_INC(bytes);
+		}
+		else if (TWI_readSize)
+		{
+			TWI_STAT_INC(transfers);
+			TWI_addressMode = true;
+			TWI_msg = TWI_readMsg + 1;
+			TWI_remaining = TWI_readSize;
+			TWI_readSize = 0;
+			TWI0.MADDR = *TWI_readMsg | (1 << TWI_READ_BIT);  // Send a repeated Start Condition and the address byte
+			TWI_STAT_INC(bytes);
+		}
+		else
+		{
+			TWI0.MCTRLB = TWI_MCMD_STOP_gc;
+			TWI_done = true;
+		}
+	}
+}
+
+#endif /* TWI_BACKEND_TWI0 */
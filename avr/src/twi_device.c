@@ -0,0 +1,131 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file twi_device.c
+ * @brief Device handles on top of the TWI backend in use (twi.c, twi0.c or the Linux i2c-dev backend).
+ *
+ */
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <util/delay.h>
+
+#include "twi.h"
+
+#ifdef TWI_STATISTICS
+	#define TWI_DEVICE_STAT_INC(device, counter) ((device)->counter++)
+	#define TWI_DEVICE_STAT_ADD(device, counter, n) ((device)->counter += (n))
+#else
+	#define TWI_DEVICE_STAT_INC(device, counter)
+	#define TWI_DEVICE_STAT_ADD(device, counter, n)
+#endif
+
+/**Decides whether a failed transmission to a device is retried.
+ *
+ * Only a lost arbitration is retried, up to TWI_ARBITRATION_RETRIES times, once the bus
+ * has gone idle.
+ *
+ * @return                   Returns true if the transmission should be retried, otherwise false.
+ */
+static bool TWI_device_retry(struct TWI_device* device, uint8_t attempt)
+{
+	uint16_t wait;
+
+	if (TWI_is_busy() || TWI_get_state_info() != TWI_UE_DATA_COL || attempt >= TWI_ARBITRATION_RETRIES)
+	{
+		TWI_DEVICE_STAT_INC(device, stats.errors);
+		return (false);
+	}
+
+	// Arbitration lost: wait for the other master's Stop Condition
+	TWI_DEVICE_STAT_INC(device, collisions);
+	for (wait = 0; wait < TWI_IDLE_TIMEOUT_US && !TWI_bus_idle(); wait++)
+	{
+		_delay_us(1);
+	}
+
+	return (true);
+}
+
+uint8_t TWI_device_transceive(struct TWI_device* device, uint8_t* msg, uint8_t msgSize)
+{
+	uint8_t attempt;
+
+	msg[0] = (device->address << TWI_ADR_BITS) | (msg[0] & (1 << TWI_READ_BIT));
+	TWI_DEVICE_STAT_INC(device, stats.transfers);
+
+	for (attempt = 0; !TWI_start_transceiver_with_data(msg, msgSize); attempt++)
+	{
+		if (!TWI_device_retry(device, attempt))
+		{
+			return (false);
+		}
+	}
+
+	TWI_DEVICE_STAT_ADD(device, stats.bytes, msgSize);
+
+	return (true);
+}
+
+uint8_t TWI_device_write_read(struct TWI_device* device, uint8_t* msg, uint8_t writeSize, uint8_t readSize)
+{
+	uint8_t attempt;
+	uint8_t out[TWI_WRITE_READ_MAX];
+	uint8_t i;
+
+#ifdef PARAM_VERIFICATION
+	if (writeSize > TWI_WRITE_READ_MAX)
+	{
+		return (false);
+	}
+#endif
+
+	// A failed read may have overwritten the bytes to write, keep them for a retry
+	out[0] = device->address << TWI_ADR_BITS;
+	for (i = 1; i < writeSize; i++)
+	{
+		out[i] = msg[i];
+	}
+	TWI_DEVICE_STAT_INC(device, stats.transfers);
+
+	for (attempt = 0; ; attempt++)
+	{
+		for (i = 0; i < writeSize; i++)
+		{
+			msg[i] = out[i];
+		}
+		if (TWI_write_read(msg, writeSize, readSize))
+		{
+			break;
+		}
+		if (!TWI_device_retry(device, attempt))
+		{
+			return (false);
+		}
+	}
+
+	TWI_DEVICE_STAT_ADD(device, stats.bytes, writeSize + readSize + 1);
+
+	return (true);
+}
\ No newline at end of file
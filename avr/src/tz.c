@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file tz.c
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "tz.h"
+
+/**Updates the cached interval of the zone to the one containing utc.
+ *
+ */
+static void tz_lookup(struct tz* zone, uint32_t utc)
+{
+	uint8_t low = 0;
+	uint8_t high = zone->count;
+
+	// Find the number of transitions at or before utc
+	while (low < high)
+	{
+		uint8_t mid = (low + high) / 2;
+
+		if (pgm_read_dword(&zone->transitions[mid]) <= utc)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	zone->from = (low > 0) ? pgm_read_dword(&zone->transitions[low - 1]) : 0;
+	zone->until = (low < zone->count) ? pgm_read_dword(&zone->transitions[low]) : UINT32_MAX;
+	zone->offset = zone->std + ((low & 1) ? zone->dst : 0);
+}
+
+int32_t tz_offset(struct tz* zone, uint32_t utc)
+{
+	if (utc < zone->from || utc >= zone->until)
+	{
+		tz_lookup(zone, utc);
+	}
+
+	return (zone->offset);
+}
+
+uint32_t tz_to_local(struct tz* zone, uint32_t utc)
+{
+	return (utc + tz_offset(zone, utc));
+}
+
+void tz_localtime(struct tz* zone, const struct time* utc, struct time* local)
+{
+	cal_from_epoch(tz_to_local(zone, cal_to_epoch(utc)), local);
+}
+
+bool tz_is_dst(struct tz* zone, uint32_t utc)
+{
+	return (tz_offset(zone, utc) != zone->std);
+}
@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file tz.h
+ * @brief Time zone and daylight saving time conversion.
+ *
+ * Transitions are kept in a PROGMEM table of UTC instants (seconds since 2000-01-01 00:00:00),
+ * built at compile time with the TZ_*_YEAR macros. DST starts at even and ends at odd indices:
+ *
+ *     static const uint32_t euTransitions[] PROGMEM = { TZ_EU_YEAR(25), TZ_EU_YEAR(26), TZ_EU_YEAR(27) };
+ *     static struct tz riga = TZ_ZONE(euTransitions, 120, 60);
+ *
+ * Each zone caches the interval between the surrounding transitions, so converting a time
+ * that falls into the same interval as the previous one needs no table lookup.
+ */
+
+#ifndef TZ_H_
+#define TZ_H_
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "calendar.h"
+
+/**Days since 2000-01-01 of the last Sunday of a month.
+ *
+ * @param[in]     y          Years since 2000 [0;99].
+ * @param[in]     m          Month [1;12].
+ * @param[in]     len        Number of days in the month.
+ */
+#define TZ_LAST_SUNDAY(y, m, len) (CAL_DAYS(y, m, len) - (CAL_DAYS(y, m, len) + 6) % 7)
+
+/**Days since 2000-01-01 of the n-th Sunday of a month.
+ *
+ * @param[in]     y          Years since 2000 [0;99].
+ * @param[in]     m          Month [1;12].
+ * @param[in]     n          Which Sunday [1;4].
+ */
+#define TZ_NTH_SUNDAY(y, m, n) (CAL_DAYS(y, m, 1) + (7 - (CAL_DAYS(y, m, 1) + 6) % 7) % 7 + 7 * ((n) - 1))
+
+/**DST transitions of the European Union for a year: last Sunday of March and October at 01:00 UTC.
+ *
+ */
+#define TZ_EU_YEAR(y) \
+	TZ_LAST_SUNDAY(y, 3, 31) * 86400UL + 3600UL, \
+	TZ_LAST_SUNDAY(y, 10, 31) * 86400UL + 3600UL
+
+/**DST transitions of the United States for a year: second Sunday of March and first Sunday of
+ * November at 02:00 local time.
+ *
+ * @param[in]     y          Years since 2000 [0;99].
+ * @param[in]     std        Standard time offset from UTC in hours, e.g. -5.
+ */
+#define TZ_US_YEAR(y, std) \
+	TZ_NTH_SUNDAY(y, 3, 2) * 86400UL + (2 - (std)) * 3600UL, \
+	TZ_NTH_SUNDAY(y, 11, 1) * 86400UL + (1 - (std)) * 3600UL
+
+/**Initializer for a struct tz.
+ *
+ * @param[in]     table      PROGMEM array of transitions.
+ * @param[in]     std        Standard time offset from UTC in minutes.
+ * @param[in]     dst        Additional offset while DST is in effect in minutes.
+ */
+#define TZ_ZONE(table, std, dst) { (table), sizeof(table) / sizeof((table)[0]), (std) * 60L, (dst) * 60L, 0, 0, 0 }
+
+struct tz
+{
+	const uint32_t* transitions;                 //!< PROGMEM table of UTC transition instants.
+	uint8_t count;                               //!< Number of transitions in the table.
+	int32_t std;                                 //!< Standard time offset from UTC in seconds.
+	int32_t dst;                                 //!< Additional offset while DST is in effect in seconds.
+	uint32_t from;                               //!< Start of the cached interval.
+	uint32_t until;                              //!< End of the cached interval.
+	int32_t offset;                              //!< Offset from UTC within the cached interval in seconds.
+};
+
+/**Gets the offset from UTC at the given instant.
+ *
+ * Times after the last transition in the table are treated as standard time.
+ *
+ * @param[in,out] zone       Time zone to use.
+ * @param[in]     utc        Seconds since 2000-01-01 00:00:00 UTC.
+ *
+ * @return                   Returns the offset from UTC in seconds.
+ */
+int32_t tz_offset(struct tz* zone, uint32_t utc);
+/**Converts UTC seconds to local seconds.
+ *
+ * @param[in,out] zone       Time zone to use.
+ * @param[in]     utc        Seconds since 2000-01-01 00:00:00 UTC.
+ *
+ * @return                   Returns the local seconds since 2000-01-01 00:00:00.
+ */
+uint32_t tz_to_local(struct tz* zone, uint32_t utc);
+/**Converts a UTC time, e.g. as read from the DS3231, to local time.
+ *
+ * @param[in,out] zone       Time zone to use.
+ * @param[in]     utc        The UTC time.
+ * @param[out]    local      Time struct to which to copy the local time.
+ */
+void tz_localtime(struct tz* zone, const struct time* utc, struct time* local);
+/**Checks whether DST is in effect at the given instant.
+ *
+ * @param[in,out] zone       Time zone to use.
+ * @param[in]     utc        Seconds since 2000-01-01 00:00:00 UTC.
+ *
+ * @return                   Returns true if DST is in effect.
+ */
+bool tz_is_dst(struct tz* zone, uint32_t utc);
+
+#endif /* TZ_H_ */
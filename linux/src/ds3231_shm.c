@@ -0,0 +1,288 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file ds3231_shm.c
+ *
+ * Reference clock daemon: publishes DS3231 time samples into an NTP shared memory
+ * (SHM) refclock segment, so chronyd or ntpd can discipline the system clock from
+ * the RTC without any further bus reads.
+ *
+ * The daemon detects the DS3231 second edge by reading the time shortly before the
+ * expected edge until the seconds change. The edge lies between the last read that
+ * showed the previous second and the first read that shows the new one, so the new
+ * second is published with the midpoint of these reads as its system time, and with
+ * a precision covering half the gap between them. A change seen by the first read
+ * after a sleep is not published, as the edge may have passed long before.
+ *
+ * Usage: ds3231_shm [-d device] [-u unit]
+ *
+ * chrony.conf: refclock SHM 2 refid RTC precision 1e-3
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ds3231.h"
+#include "twi_i2cdev.h"
+
+#define SHM_KEY_BASE   0x4E545030                //!< Key of SHM unit 0 ("NTP0").
+#define POLL_LEAD_NS   20000000L                 //!< Start polling this long before the expected second edge.
+#define POLL_PERIOD_NS 1000000L                  //!< Interval between reads while waiting for the edge.
+
+/**NTP SHM refclock segment layout, as read by chronyd and ntpd.
+ *
+ */
+struct shmTime {
+	int mode;                                    //!< 1: use count to detect concurrent updates.
+	volatile int count;                          //!< Incremented before and after each update.
+	time_t clockTimeStampSec;                    //!< Reference (DS3231) time, seconds.
+	int clockTimeStampUSec;                      //!< Reference time, microseconds.
+	time_t receiveTimeStampSec;                  //!< System time of the sample, seconds.
+	int receiveTimeStampUSec;                    //!< System time of the sample, microseconds.
+	int leap;                                    //!< Leap second indicator.
+	int precision;                               //!< Precision as a power of two in seconds.
+	int nsamples;                                //!< Unused.
+	volatile int valid;                          //!< Set when the sample may be consumed.
+	unsigned clockTimeStampNSec;                 //!< Reference time, nanoseconds.
+	unsigned receiveTimeStampNSec;               //!< System time of the sample, nanoseconds.
+	int dummy[8];                                //!< Reserved.
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int signum)
+{
+	(void)signum;
+	running = 0;
+}
+
+/**Attaches the SHM segment of the given unit, creating it if needed.
+ *
+ * Units 0 and 1 are only accessible to root, like in ntpd.
+ */
+static struct shmTime* shm_attach(int unit)
+{
+	int id = shmget(SHM_KEY_BASE + unit, sizeof(struct shmTime), IPC_CREAT | ((unit < 2) ? 0600 : 0666));
+	void* shm;
+
+	if (id < 0)
+	{
+		return (NULL);
+	}
+
+	shm = shmat(id, NULL, 0);
+
+	return (shm == (void*)-1) ? NULL : shm;
+}
+
+/**Publishes a sample using the mode 1 count protocol.
+ *
+ */
+static void shm_publish(struct shmTime* shm, time_t clockSec, const struct timespec* receive, int precision)
+{
+	shm->valid = 0;
+	shm->count++;
+	__sync_synchronize();
+
+	shm->mode = 1;
+	shm->clockTimeStampSec = clockSec;
+	shm->clockTimeStampUSec = 0;
+	shm->clockTimeStampNSec = 0;
+	shm->receiveTimeStampSec = receive->tv_sec;
+	shm->receiveTimeStampUSec = receive->tv_nsec / 1000;
+	shm->receiveTimeStampNSec = receive->tv_nsec;
+	shm->leap = 0;
+	shm->precision = precision;
+
+	__sync_synchronize();
+	shm->count++;
+	shm->valid = 1;
+}
+
+/**Reads the DS3231 time and the system time at the middle of the read.
+ *
+ */
+static uint8_t read_time(struct time* time_, struct timespec* when)
+{
+	struct timespec before;
+	struct timespec after;
+	uint8_t result;
+	long long ns;
+
+	clock_gettime(CLOCK_REALTIME, &before);
+	result = ds3231_get_time(time_);
+	clock_gettime(CLOCK_REALTIME, &after);
+	ds3231_12h_translate(time_);                 // Hour is not decoded in 12-hour mode
+
+	ns = ((after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec)) / 2;
+	ns += before.tv_nsec;
+	when->tv_sec = before.tv_sec + ns / 1000000000LL;
+	when->tv_nsec = ns % 1000000000LL;
+
+	return (result);
+}
+
+/**Returns a system time in nanoseconds.
+ *
+ */
+static long long timespec_ns(const struct timespec* ts)
+{
+	return (ts->tv_sec * 1000000000LL + ts->tv_nsec);
+}
+
+/**Returns the precision of an edge estimate: the smallest power of two in seconds
+ * covering half the gap between the reads before and after the edge.
+ *
+ */
+static int edge_precision(long long gapNs)
+{
+	int precision = 0;
+
+	while (precision > -30 && (1000000000LL >> (1 - precision)) >= gapNs / 2)
+	{
+		precision--;
+	}
+
+	return (precision);
+}
+
+/**Converts a DS3231 time to seconds since the Unix epoch (the DS3231 keeps UTC).
+ *
+ */
+static time_t to_unix(const struct time* time_)
+{
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_sec = time_->sec;
+	tm.tm_min = time_->min;
+	tm.tm_hour = time_->hour;
+	tm.tm_mday = time_->mday;
+	tm.tm_mon = time_->mon - 1;
+	tm.tm_year = time_->year;
+
+	return (timegm(&tm));
+}
+
+int main(int argc, char** argv)
+{
+	const char* device = TWI_I2C_DEVICE;
+	int unit = 2;
+	int opt;
+	struct shmTime* shm;
+	struct time now;
+	struct timespec when;
+	struct timespec lastWhen;                    // System time of the last read showing lastSec
+	struct timespec edge;
+	long long edgeNs;
+	struct timespec pause;
+	uint8_t lastSec = 0xFF;
+	bool armed = false;                          // Set once a read has seen the current second
+
+	while ((opt = getopt(argc, argv, "d:u:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd':
+				device = optarg;
+				break;
+			case 'u':
+				unit = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-d device] [-u unit]\n", argv[0]);
+				return (EXIT_FAILURE);
+		}
+	}
+
+	if (!TWI_master_open(device))
+	{
+		perror(device);
+		return (EXIT_FAILURE);
+	}
+
+	shm = shm_attach(unit);
+	if (!shm)
+	{
+		perror("shm");
+		return (EXIT_FAILURE);
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	while (running)
+	{
+		if (read_time(&now, &when) != DS3231_OK)
+		{
+			armed = false;                       // Resynchronise after a failed read
+			sleep(1);
+			continue;
+		}
+
+		if (now.sec == lastSec)
+		{
+			// Edge not seen yet
+			armed = true;
+			lastWhen = when;
+			pause.tv_sec = 0;
+			pause.tv_nsec = POLL_PERIOD_NS;
+			nanosleep(&pause, NULL);
+			continue;
+		}
+
+		lastSec = now.sec;
+		if (!armed)
+		{
+			// The change happened before this read started, so the edge time is unknown: poll for the next one
+			continue;
+		}
+		armed = false;
+
+		// This read is the first one to see the new second, the previous one still saw the old one
+		edgeNs = (timespec_ns(&lastWhen) + timespec_ns(&when)) / 2;
+		edge.tv_sec = edgeNs / 1000000000LL;
+		edge.tv_nsec = edgeNs % 1000000000LL;
+		shm_publish(shm, to_unix(&now), &edge, edge_precision(timespec_ns(&when) - timespec_ns(&lastWhen)));
+
+		// Sleep until shortly before the next edge
+		edge.tv_nsec += 1000000000L - POLL_LEAD_NS;
+		if (edge.tv_nsec >= 1000000000L)
+		{
+			edge.tv_sec++;
+			edge.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &edge, NULL);
+	}
+
+	shmdt(shm);
+
+	return (EXIT_SUCCESS);
+}
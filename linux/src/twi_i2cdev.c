@@ -0,0 +1,299 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file twi_i2cdev.c
+ *
+ * TWI master on a Linux i2c-dev bus. Every transmission is issued as one I2C_RDWR
+ * message, and TWI_write_read() as one combined transaction of a write and a read
+ * message with a repeated Start.
+ *
+ * Transmissions are recorded into a trace file when one is opened with TWI_trace_open()
+ * or named by the TWI_TRACE environment variable; TWI_write_read() is recorded as its
+ * write and its read.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "twi_i2cdev.h"
+
+#ifdef TWI_STATISTICS
+	#define TWI_STAT_INC(counter)    (TWI_stats.counter++)
+	#define TWI_STAT_ADD(counter, n) (TWI_stats.counter += (n))
+#else
+	#define TWI_STAT_INC(counter)
+	#define TWI_STAT_ADD(counter, n)
+#endif
+
+static int TWI_fd = -1;                          //!< File descriptor of the open bus.
+static uint8_t TWI_errorState;                   //!< Error information about the last transmission.
+static bool TWI_busy;                            //!< Set while a transmission is in progress.
+static FILE* TWI_traceFile;                      //!< Trace being recorded, NULL if none.
+
+#ifdef TWI_STATISTICS
+struct TWI_stats TWI_stats;
+
+void TWI_get_stats(struct TWI_stats* stats)
+{
+	*stats = TWI_stats;
+}
+
+void TWI_reset_stats(void)
+{
+	TWI_stats.transfers = 0;
+	TWI_stats.bytes = 0;
+	TWI_stats.errors = 0;
+}
+#endif
+
+uint8_t TWI_get_state_info(void)
+{
+	return TWI_errorState;
+}
+
+bool TWI_is_busy(void)
+{
+	return (TWI_busy);
+}
+
+bool TWI_bus_idle(void)
+{
+	return (true);                               // The adapter driver waits for a busy bus itself
+}
+
+uint8_t TWI_master_open(const char* device)
+{
+	if (TWI_fd >= 0)
+	{
+		close(TWI_fd);
+	}
+
+	if (!TWI_traceFile && getenv(TWI_TRACE_ENV))
+	{
+		TWI_trace_open(getenv(TWI_TRACE_ENV));
+	}
+
+	TWI_fd = open(device, O_RDWR);
+
+	return (TWI_fd >= 0);
+}
+
+void TWI_master_initialize(void)
+{
+	TWI_master_open(TWI_I2C_DEVICE);
+}
+
+uint8_t TWI_trace_open(const char* path)
+{
+	if (TWI_traceFile)
+	{
+		fclose(TWI_traceFile);
+		TWI_traceFile = NULL;
+	}
+	if (!path)
+	{
+		return (true);
+	}
+
+	TWI_traceFile = fopen(path, "wb");
+	if (!TWI_traceFile)
+	{
+		return (false);
+	}
+	fputs(TWI_TRACE_MAGIC, TWI_traceFile);
+	fputc(TWI_TRACE_VERSION, TWI_traceFile);
+
+	return (true);
+}
+
+void TWI_trace_mark(const char* api)
+{
+	size_t length;
+
+	if (!TWI_traceFile)
+	{
+		return;
+	}
+
+	length = strlen(api);
+	if (length > UINT8_MAX)
+	{
+		length = UINT8_MAX;
+	}
+	fputc(TWI_TRACE_MARK, TWI_traceFile);
+	fputc(length, TWI_traceFile);
+	fwrite(api, 1, length, TWI_traceFile);
+	fflush(TWI_traceFile);
+}
+
+/**Records a transmission into the trace.
+ *
+ */
+static void TWI_trace_transfer(uint8_t address, uint8_t msgSize, uint8_t result)
+{
+	if (!TWI_traceFile)
+	{
+		return;
+	}
+
+	fputc(TWI_TRACE_TRANSFER, TWI_traceFile);
+	fputc(address, TWI_traceFile);
+	fputc(msgSize, TWI_traceFile);
+	fputc(result, TWI_traceFile);
+	fflush(TWI_traceFile);                       // Keep the trace complete if the process is killed
+}
+
+/**Translates the errno of a failed I2C_RDWR into TWI error information.
+ *
+ */
+static uint8_t TWI_error_from_errno(int error)
+{
+	switch (error)
+	{
+		case ENXIO:
+		case EREMOTEIO:
+			return (TWI_NO_ACK_ON_ADDRESS);      // No acknowledge (the adapter cannot tell address from data)
+		case EAGAIN:
+			return (TWI_UE_DATA_COL);            // Arbitration lost
+		case EFAULT:
+		case EINVAL:
+			return (TWI_DATA_OUT_OF_BOUND);
+		default:
+			return (TWI_MISSING_START_CON);      // Bus stuck or adapter error
+	}
+}
+
+/**Issues one or two messages as a single combined transaction.
+ *
+ * @param[in]     msgs       Messages to transfer.
+ * @param[in]     count      Number of messages.
+ * @return                   Returns 1 if the transaction was completed successfully, otherwise 0.
+ */
+static uint8_t TWI_transfer(struct i2c_msg* msgs, uint8_t count)
+{
+	struct i2c_rdwr_ioctl_data data = { msgs, count };
+
+	if (ioctl(TWI_fd, I2C_RDWR, &data) < 0)
+	{
+		TWI_errorState = TWI_error_from_errno(errno);
+		return (false);
+	}
+
+	return (true);
+}
+
+/**Fills an i2c_msg from a transmission buffer in the twi.h format.
+ *
+ */
+static void TWI_to_i2c_msg(struct i2c_msg* out, uint8_t* msg, uint8_t msgSize)
+{
+	out->addr = msg[0] >> TWI_ADR_BITS;
+	out->flags = (msg[0] & (1 << TWI_READ_BIT)) ? I2C_M_RD : 0;
+	out->len = msgSize - 1;
+	out->buf = msg + 1;
+}
+
+/**Performs a transmission, followed by a read after a repeated Start if readSize is not 0.
+ *
+ */
+static uint8_t TWI_transceive(uint8_t *msg, uint8_t msgSize, uint8_t readSize)
+{
+	struct i2c_msg msgs[2];
+	uint8_t out[UINT8_MAX];
+	uint8_t count = 1;
+	uint8_t result;
+
+	if (TWI_busy)
+	{
+		return (false);                          // Leave the error information to the transmission in progress
+	}
+	TWI_busy = true;
+
+	TWI_errorState = 0;
+	TWI_STAT_INC(transfers);
+
+	if (TWI_fd < 0 || msgSize <= 1)
+	{
+		TWI_errorState = (TWI_fd < 0) ? TWI_MISSING_START_CON : TWI_NO_DATA;
+		TWI_STAT_INC(errors);
+		TWI_busy = false;
+		return (false);
+	}
+
+	TWI_to_i2c_msg(&msgs[0], msg, msgSize);
+	if (readSize)
+	{
+		// The read is stored over the bytes written, which the adapter may still be sending
+		memcpy(out, msg + 1, msgSize - 1);
+		msgs[0].buf = out;
+		msgs[1].addr = msgs[0].addr;
+		msgs[1].flags = I2C_M_RD;
+		msgs[1].len = readSize;
+		msgs[1].buf = msg + 1;
+		count = 2;
+		TWI_STAT_INC(transfers);
+	}
+
+	result = TWI_transfer(msgs, count);
+	if (result)
+	{
+		TWI_STAT_ADD(bytes, msgSize + (readSize ? readSize + 1 : 0));
+	}
+	else
+	{
+		TWI_STAT_INC(errors);
+	}
+
+	TWI_busy = false;
+
+	return (result);
+}
+
+uint8_t TWI_start_transceiver_with_data(uint8_t *msg, uint8_t msgSize)
+{
+	uint8_t result = TWI_transceive(msg, msgSize, 0);
+
+	TWI_trace_transfer(msgSize ? msg[0] : 0, msgSize, result);
+
+	return (result);
+}
+
+uint8_t TWI_write_read(uint8_t *msg, uint8_t writeSize, uint8_t readSize)
+{
+	uint8_t address = writeSize ? msg[0] : 0;
+	uint8_t result = TWI_transceive(msg, writeSize, readSize);
+
+	TWI_trace_transfer(address, writeSize, result);
+	TWI_trace_transfer(address | (1 << TWI_READ_BIT), readSize + 1, result);
+
+	return (result);
+}
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file twi_i2cdev.h
+ * @brief Linux i2c-dev backend for the TWI API in twi.h.
+ *
+ */
+
+#ifndef TWI_I2CDEV_H_
+#define TWI_I2CDEV_H_
+
+#include <stdint.h>
+
+#include "twi.h"
+
+#ifndef TWI_I2C_DEVICE
+	#define TWI_I2C_DEVICE "/dev/i2c-1"          //!< Bus opened by TWI_master_initialize().
+#endif
+
+/**Opens the given i2c-dev bus, closing any bus opened before.
+ *
+ * @param[in]     device     Path of the bus device, e.g. "/dev/i2c-1".
+ * @return                   Returns 1 if the bus was opened successfully, otherwise 0.
+ */
+uint8_t TWI_master_open(const char* device);
+
+/**@name Bus trace
+ * Every TWI_start_transceiver_with_data() call, and the write and the read of every
+ * TWI_write_read() call, can be recorded into a trace file, to be summarised or
+ * compared against a baseline trace with twi_trace. The file starts with
+ * TWI_TRACE_MAGIC and TWI_TRACE_VERSION, followed by records:
+ *  - TWI_TRACE_TRANSFER, address byte, message size, result (1 on success)
+ *  - TWI_TRACE_MARK, name length, name (without terminator)
+ *
+ * Transfers are attributed to the API named by the last mark.
+ */
+/**@{*/
+#define TWI_TRACE_MAGIC    "TWIT"                //!< First bytes of a trace file.
+#define TWI_TRACE_VERSION  1                     //!< Trace format version.
+#define TWI_TRACE_TRANSFER 0x01                  //!< Record of one transmission.
+#define TWI_TRACE_MARK     0x02                  //!< Record naming the API issuing the following transmissions.
+#define TWI_TRACE_ENV      "TWI_TRACE"           //!< Environment variable naming a trace file opened by TWI_master_open().
+/**@}*/
+
+/**Starts recording transmissions into the given file, replacing its contents.
+ *
+ * @param[in]     path       Path of the trace file, NULL to stop recording.
+ * @return                   Returns 1 if the file was opened successfully, otherwise 0.
+ */
+uint8_t TWI_trace_open(const char* path);
+
+/**Attributes the following transmissions to the given API in the trace.
+ *
+ * Does nothing unless a trace is being recorded.
+ *
+ * @param[in]     api        Name of the API, at most 255 characters.
+ */
+void TWI_trace_mark(const char* api);
+
+#endif /* TWI_I2CDEV_H_ */
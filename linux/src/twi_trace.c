@@ -0,0 +1,293 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file twi_trace.c
+ *
+ * Summarises a bus trace recorded by twi_i2cdev.c, or compares it against a baseline
+ * trace. For each API named by the trace marks the transmission count, byte count and
+ * modelled bus time are totalled; bus time counts a Start, the bytes with their
+ * acknowledge bits and a Stop at the given SCL frequency.
+ *
+ * With a baseline, every API that needs more transmissions, bytes or bus time than in
+ * the baseline, or that is missing from the trace, is reported and the exit status is
+ * 1, so a build can fail on it. APIs without a baseline are listed but do not fail.
+ *
+ * Usage: twi_trace [-f kHz] trace [baseline]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "twi_i2cdev.h"
+
+#define TRACE_APIS     128                       //!< Maximum number of distinct APIs in a trace.
+#define TRACE_UNMARKED "(unmarked)"              //!< API of transmissions before the first mark.
+
+/**Totals of one API.
+ *
+ */
+struct api {
+	char name[UINT8_MAX + 1];                    //!< API name from the trace mark.
+	unsigned long transfers;                     //!< Number of transmissions.
+	unsigned long bytes;                         //!< Bytes on the bus, including the address byte.
+	unsigned long errors;                        //!< Failed transmissions.
+	unsigned long long bits;                     //!< Modelled SCL cycles.
+};
+
+/**Totals of one trace file.
+ *
+ */
+struct trace {
+	struct api apis[TRACE_APIS];                 //!< APIs in the order of their first mark.
+	unsigned count;                              //!< Number of APIs.
+};
+
+/**Finds an API in a trace, adding it if create is set.
+ *
+ */
+static struct api* trace_find(struct trace* trace, const char* name, int create)
+{
+	unsigned i;
+
+	for (i = 0; i < trace->count; i++)
+	{
+		if (strcmp(trace->apis[i].name, name) == 0)
+		{
+			return (&trace->apis[i]);
+		}
+	}
+	if (!create || trace->count == TRACE_APIS)
+	{
+		return (NULL);
+	}
+
+	memset(&trace->apis[trace->count], 0, sizeof(struct api));
+	strcpy(trace->apis[trace->count].name, name);
+
+	return (&trace->apis[trace->count++]);
+}
+
+/**Reads and totals a trace file.
+ *
+ * @return                   Returns 1 if the file was read successfully, otherwise 0.
+ */
+static int trace_load(const char* path, struct trace* trace)
+{
+	char magic[sizeof(TWI_TRACE_MAGIC)];
+	char name[UINT8_MAX + 1];
+	unsigned char record[3];
+	struct api* api = NULL;
+	FILE* file;
+	int type;
+	int ok = 1;
+
+	trace->count = 0;
+
+	file = fopen(path, "rb");
+	if (!file)
+	{
+		perror(path);
+		return (0);
+	}
+
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+		|| memcmp(magic, TWI_TRACE_MAGIC, sizeof(magic) - 1) != 0
+		|| magic[sizeof(magic) - 1] != TWI_TRACE_VERSION)
+	{
+		fprintf(stderr, "%s: not a version %d bus trace\n", path, TWI_TRACE_VERSION);
+		fclose(file);
+		return (0);
+	}
+
+	while (ok && (type = fgetc(file)) != EOF)
+	{
+		switch (type)
+		{
+			case TWI_TRACE_MARK:
+				type = fgetc(file);
+				if (type == EOF || fread(name, 1, type, file) != (size_t)type)
+				{
+					ok = 0;
+					break;
+				}
+				name[type] = '\0';
+				api = trace_find(trace, name, 1);
+				ok = (api != NULL);
+				break;
+			case TWI_TRACE_TRANSFER:
+				if (fread(record, 1, sizeof(record), file) != sizeof(record))
+				{
+					ok = 0;
+					break;
+				}
+				if (!api)
+				{
+					api = trace_find(trace, TRACE_UNMARKED, 1);
+				}
+				api->transfers++;
+				api->bytes += record[1];
+				api->errors += !record[2];
+				api->bits += 2 + 9 * record[1];  // Start, bytes with acknowledge, Stop
+				break;
+			default:
+				ok = 0;
+				break;
+		}
+	}
+
+	if (!ok)
+	{
+		fprintf(stderr, "%s: corrupt record at offset %ld\n", path, ftell(file));
+	}
+	fclose(file);
+
+	return (ok);
+}
+
+/**Converts SCL cycles into microseconds at the given frequency.
+ *
+ */
+static unsigned long long bus_time_us(unsigned long long bits, unsigned long kHz)
+{
+	return ((bits * 1000 + kHz / 2) / kHz);
+}
+
+static void print_summary(const struct trace* trace, unsigned long kHz)
+{
+	unsigned i;
+
+	printf("%-32s %10s %10s %10s %12s\n", "api", "transfers", "bytes", "errors", "time [us]");
+	for (i = 0; i < trace->count; i++)
+	{
+		const struct api* api = &trace->apis[i];
+
+		printf("%-32s %10lu %10lu %10lu %12llu\n", api->name, api->transfers, api->bytes, api->errors,
+			bus_time_us(api->bits, kHz));
+	}
+}
+
+/**Prints a trace against its baseline.
+ *
+ * @return                   Returns the number of APIs that got more expensive or are missing.
+ */
+static unsigned print_diff(struct trace* trace, struct trace* baseline, unsigned long kHz)
+{
+	unsigned regressions = 0;
+	unsigned i;
+
+	printf("%-32s %16s %16s %20s\n", "api", "transfers", "bytes", "time [us]");
+	for (i = 0; i < trace->count; i++)
+	{
+		const struct api* api = &trace->apis[i];
+		const struct api* base = trace_find(baseline, api->name, 0);
+		const char* verdict = "";
+
+		if (!base)
+		{
+			printf("%-32s %16lu %16lu %20llu  new\n", api->name, api->transfers, api->bytes,
+				bus_time_us(api->bits, kHz));
+			continue;
+		}
+
+		if (api->transfers > base->transfers || api->bytes > base->bytes || api->bits > base->bits)
+		{
+			verdict = "  REGRESSION";
+			regressions++;
+		}
+		printf("%-32s %7lu (%+6ld) %7lu (%+6ld) %10llu (%+7lld)%s\n", api->name,
+			api->transfers, (long)api->transfers - (long)base->transfers,
+			api->bytes, (long)api->bytes - (long)base->bytes,
+			bus_time_us(api->bits, kHz), (long long)bus_time_us(api->bits, kHz) - (long long)bus_time_us(base->bits, kHz),
+			verdict);
+	}
+
+	for (i = 0; i < baseline->count; i++)
+	{
+		if (!trace_find(trace, baseline->apis[i].name, 0))
+		{
+			printf("%-32s %16s %16s %20s  MISSING\n", baseline->apis[i].name, "-", "-", "-");
+			regressions++;
+		}
+	}
+
+	return (regressions);
+}
+
+int main(int argc, char** argv)
+{
+	static struct trace trace;
+	static struct trace baseline;
+	unsigned long kHz = 100;
+	unsigned regressions;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+				kHz = strtoul(optarg, NULL, 10);
+				if (kHz)
+				{
+					break;
+				}
+				// Fall through
+			default:
+				fprintf(stderr, "Usage: %s [-f kHz] trace [baseline]\n", argv[0]);
+				return (2);
+		}
+	}
+	if (optind != argc - 1 && optind != argc - 2)
+	{
+		fprintf(stderr, "Usage: %s [-f kHz] trace [baseline]\n", argv[0]);
+		return (2);
+	}
+
+	if (!trace_load(argv[optind], &trace))
+	{
+		return (2);
+	}
+
+	if (optind == argc - 1)
+	{
+		print_summary(&trace, kHz);
+		return (EXIT_SUCCESS);
+	}
+
+	if (!trace_load(argv[optind + 1], &baseline))
+	{
+		return (2);
+	}
+
+	regressions = print_diff(&trace, &baseline, kHz);
+	if (regressions)
+	{
+		printf("%u API(s) got more expensive or are missing\n", regressions);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file fake_clock.c
+ *
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fake_clock.h"
+#include "i2c_fake.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+uint64_t fake_clock_end = UINT64_MAX;
+
+/**Advances the bus time by a sleep, raising SIGTERM once fake_clock_end is reached.
+ *
+ */
+static void fake_sleep(uint64_t ns)
+{
+	i2c_fake_advance(ns);
+	if (i2c_fake.now >= fake_clock_end)
+	{
+		fake_clock_end = UINT64_MAX;
+		raise(SIGTERM);
+	}
+}
+
+int clock_gettime(clockid_t clock, struct timespec* ts)
+{
+	(void)clock;
+	ts->tv_sec = i2c_fake.now / NS_PER_SEC;
+	ts->tv_nsec = i2c_fake.now % NS_PER_SEC;
+
+	return (0);
+}
+
+int nanosleep(const struct timespec* request, struct timespec* remain)
+{
+	fake_sleep(request->tv_sec * NS_PER_SEC + request->tv_nsec);
+	if (remain)
+	{
+		remain->tv_sec = 0;
+		remain->tv_nsec = 0;
+	}
+
+	return (0);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* request, struct timespec* remain)
+{
+	uint64_t ns = request->tv_sec * NS_PER_SEC + request->tv_nsec;
+
+	(void)clock;
+	if (flags & TIMER_ABSTIME)
+	{
+		ns = (ns > i2c_fake.now) ? ns - i2c_fake.now : 0;
+	}
+
+	return (nanosleep(&(struct timespec){ ns / NS_PER_SEC, ns % NS_PER_SEC }, remain));
+}
+
+unsigned sleep(unsigned seconds)
+{
+	fake_sleep(seconds * NS_PER_SEC);
+
+	return (0);
+}
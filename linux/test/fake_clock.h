@@ -0,0 +1,44 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file fake_clock.h
+ * @brief Clocks and sleeps running on the time of the fake bus.
+ *
+ * Linking fake_clock.c together with i2c_fake.c replaces clock_gettime(), nanosleep(),
+ * clock_nanosleep() and sleep(): every clock reads the bus time, and a sleep advances
+ * it without waiting, so a program polling the DS3231 runs deterministically.
+ */
+
+#ifndef FAKE_CLOCK_H_
+#define FAKE_CLOCK_H_
+
+#include <stdint.h>
+
+/**Bus time in ns at which the next sleep raises SIGTERM, UINT64_MAX for never.
+ *
+ * Ends a daemon that stops on SIGTERM once it has run for long enough.
+ */
+extern uint64_t fake_clock_end;
+
+#endif /* FAKE_CLOCK_H_ */
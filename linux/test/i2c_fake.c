@@ -0,0 +1,302 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file i2c_fake.c
+ *
+ * The fake bus is backed by a descriptor of /dev/null, so its number cannot be taken by
+ * another file while it is open. Calls that do not concern the fake bus are issued as
+ * raw system calls, as the C library entry points are the ones replaced here.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "i2c_fake.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+struct i2c_fake i2c_fake;
+
+static int fakeFd = -1;                          //!< Descriptor of the open fake bus.
+
+void i2c_fake_reset(uint64_t now, uint64_t edge)
+{
+	memset(&i2c_fake, 0, sizeof(i2c_fake));
+	ds3231_model_init(&i2c_fake.rtc);
+	memset(i2c_fake.eeprom.mem, 0xFF, sizeof(i2c_fake.eeprom.mem));
+	i2c_fake.now = now;
+	i2c_fake.edge = edge;
+	i2c_fake.rtc.now = now / 1000;
+}
+
+void i2c_fake_advance(uint64_t ns)
+{
+	i2c_fake.now += ns;
+	while (i2c_fake.now >= i2c_fake.edge)
+	{
+		i2c_fake.rtc.now = i2c_fake.edge / 1000;
+		ds3231_model_tick(&i2c_fake.rtc);
+		i2c_fake.edge += NS_PER_SEC;
+	}
+	i2c_fake.rtc.now = i2c_fake.now / 1000;
+}
+
+/**Clocks a byte out to the slave.
+ *
+ * @return                   Returns true if the slave acknowledged it.
+ */
+static bool bus_write(uint8_t byte)
+{
+	bool ack;
+
+	for (uint8_t bit = 0x80; bit; bit >>= 1)
+	{
+		ds3231_model_scl_rise(&i2c_fake.rtc, byte & bit);
+		ds3231_model_scl_fall(&i2c_fake.rtc);
+	}
+
+	ack = i2c_fake.rtc.sdaLow;
+	ds3231_model_scl_rise(&i2c_fake.rtc, !ack);
+	ds3231_model_scl_fall(&i2c_fake.rtc);
+
+	return (ack);
+}
+
+/**Clocks a byte in from the slave and acknowledges it if more are to follow.
+ *
+ */
+static uint8_t bus_read(bool ack)
+{
+	uint8_t byte = 0;
+	bool sda;
+
+	for (uint8_t bit = 0; bit < 8; bit++)
+	{
+		sda = !i2c_fake.rtc.sdaLow;
+		byte = (byte << 1) | sda;
+		ds3231_model_scl_rise(&i2c_fake.rtc, sda);
+		ds3231_model_scl_fall(&i2c_fake.rtc);
+	}
+
+	ds3231_model_scl_rise(&i2c_fake.rtc, !ack);
+	ds3231_model_scl_fall(&i2c_fake.rtc);
+
+	return (byte);
+}
+
+/**Transfers a message to or from the EEPROM.
+ *
+ * The first two bytes written set the address counter; further bytes are written
+ * within its page and start a write cycle at the end of the transaction.
+ *
+ * @param[in,out] msg        The message.
+ * @param[out]    write      Set if data bytes were written.
+ *
+ * @return                   Returns 0 on success, otherwise an errno value.
+ */
+static int eeprom_transfer(const struct i2c_msg* msg, bool* write)
+{
+	struct i2c_fake_eeprom* ee = &i2c_fake.eeprom;
+	uint16_t page = 0;
+	uint8_t start = 0;
+
+	if (i2c_fake.now < ee->busyUntil)
+	{
+		ee->nacks++;
+		return (ENXIO);
+	}
+
+	for (uint16_t n = 0; n < msg->len; n++)
+	{
+		if (msg->flags & I2C_M_RD)
+		{
+			msg->buf[n] = ee->mem[ee->pointer];
+			ee->pointer = (ee->pointer + 1) % I2C_FAKE_EEPROM_SIZE;
+		}
+		else if (n == 0)
+		{
+			ee->pointer = (msg->buf[n] << 8) % I2C_FAKE_EEPROM_SIZE;
+		}
+		else if (n == 1)
+		{
+			ee->pointer |= msg->buf[n];
+			page = ee->pointer - ee->pointer % I2C_FAKE_EEPROM_PAGE;
+			start = ee->pointer % I2C_FAKE_EEPROM_PAGE;
+		}
+		else
+		{
+			if (start + n - 2 >= I2C_FAKE_EEPROM_PAGE)
+			{
+				ee->wraps++;
+			}
+			ee->mem[page + (start + n - 2) % I2C_FAKE_EEPROM_PAGE] = msg->buf[n];
+			*write = true;
+		}
+	}
+
+	return (0);
+}
+
+/**Performs an I2C_RDWR combined transaction, like an i2c adapter driver.
+ *
+ * @return                   Returns 0 on success, otherwise an errno value.
+ */
+static int bus_transfer(const struct i2c_rdwr_ioctl_data* data)
+{
+	uint64_t bits = 1;                           // Stop Condition
+	bool eepromWrite = false;
+	int result = 0;
+
+	if (!data || !data->msgs || data->nmsgs == 0 || data->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS)
+	{
+		return (EINVAL);
+	}
+
+	i2c_fake.ioctls++;
+	if (i2c_fake.error)
+	{
+		result = i2c_fake.error;
+		i2c_fake.error = 0;
+		return (result);
+	}
+
+	for (uint32_t i = 0; i < data->nmsgs && !result; i++)
+	{
+		const struct i2c_msg* msg = &data->msgs[i];
+		bool read = msg->flags & I2C_M_RD;
+
+		if (msg->addr == I2C_FAKE_EEPROM_ADDRESS)
+		{
+			i2c_fake.msgs++;
+			result = eeprom_transfer(msg, &eepromWrite);
+			bits += 1 + 9 + (result ? 0 : 9 * msg->len);
+			i2c_fake.bytes += 1 + (result ? 0 : msg->len);
+			continue;
+		}
+
+		ds3231_model_start(&i2c_fake.rtc);   // Start or repeated Start Condition
+		bits += 1 + 9;
+		i2c_fake.msgs++;
+		i2c_fake.bytes++;
+		if (!bus_write((msg->addr << 1) | read))
+		{
+			result = ENXIO;
+			break;
+		}
+
+		for (uint16_t n = 0; n < msg->len; n++)
+		{
+			bits += 9;
+			i2c_fake.bytes++;
+			if (read)
+			{
+				msg->buf[n] = bus_read(n + 1 < msg->len);
+			}
+			else if (!bus_write(msg->buf[n]))
+			{
+				result = EREMOTEIO;
+				break;
+			}
+		}
+	}
+
+	ds3231_model_stop(&i2c_fake.rtc);
+	i2c_fake_advance(bits * NS_PER_SEC / I2C_FAKE_SCL_HZ);
+	if (eepromWrite)
+	{
+		i2c_fake.eeprom.busyUntil = i2c_fake.now + I2C_FAKE_EEPROM_TWR;
+		i2c_fake.eeprom.writes++;
+	}
+
+	return (result);
+}
+
+int open(const char* path, int flags, ...)
+{
+	va_list args;
+	mode_t mode = 0;
+
+	if (flags & O_CREAT)
+	{
+		va_start(args, flags);
+		mode = va_arg(args, mode_t);
+		va_end(args);
+	}
+
+	if (strcmp(path, I2C_FAKE_DEVICE))
+	{
+		return (syscall(SYS_openat, AT_FDCWD, path, flags, mode));
+	}
+
+	if (fakeFd >= 0)
+	{
+		errno = EBUSY;
+		return (-1);
+	}
+	fakeFd = syscall(SYS_openat, AT_FDCWD, "/dev/null", O_RDWR, 0);
+
+	return (fakeFd);
+}
+
+int close(int fd)
+{
+	if (fd >= 0 && fd == fakeFd)
+	{
+		fakeFd = -1;
+	}
+
+	return (syscall(SYS_close, fd));
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	va_list args;
+	void* arg;
+	int error;
+
+	va_start(args, request);
+	arg = va_arg(args, void*);
+	va_end(args);
+
+	if (fd < 0 || fd != fakeFd)
+	{
+		return (syscall(SYS_ioctl, fd, request, arg));
+	}
+
+	error = (request == I2C_RDWR) ? bus_transfer(arg) : ENOTTY;
+	if (error)
+	{
+		errno = error;
+		return (-1);
+	}
+
+	return (0);
+}
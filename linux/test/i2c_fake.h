@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file i2c_fake.h
+ * @brief In-process i2c-dev bus with a DS3231 and an AT24C32 for the Linux backend tests.
+ *
+ * Linking i2c_fake.c into a program replaces open(), close() and ioctl(): opening
+ * I2C_FAKE_DEVICE gives a descriptor on which I2C_RDWR clocks every message bit by bit
+ * through the DS3231 model of the simavr benchmarks (avr/bench/sim/ds3231_model.c).
+ * Other paths and descriptors are passed to the kernel.
+ *
+ * The bus keeps its own time: each transaction advances it by its duration at
+ * I2C_FAKE_SCL_HZ, and the model ticks whenever the time passes a second edge.
+ *
+ * An AT24C32 EEPROM at I2C_FAKE_EEPROM_ADDRESS is modelled byte by byte: it rolls
+ * over within a page like the real device, and does not acknowledge its address
+ * for I2C_FAKE_EEPROM_TWR after a write.
+ */
+
+#ifndef I2C_FAKE_H_
+#define I2C_FAKE_H_
+
+#include <stdint.h>
+
+#include "ds3231_model.h"
+
+#define I2C_FAKE_DEVICE "/dev/i2c-fake"          //!< Path opened as the fake bus.
+#define I2C_FAKE_SCL_HZ 100000UL                 //!< Modelled bus clock.
+
+#define I2C_FAKE_EEPROM_ADDRESS 0x57             //!< 7-bit address of the AT24C32.
+#define I2C_FAKE_EEPROM_SIZE    4096             //!< EEPROM size in bytes.
+#define I2C_FAKE_EEPROM_PAGE    32               //!< EEPROM page size in bytes.
+#define I2C_FAKE_EEPROM_TWR     5000000ULL       //!< Write cycle time in ns.
+
+/**State of the AT24C32.
+ *
+ */
+struct i2c_fake_eeprom {
+	uint8_t mem[I2C_FAKE_EEPROM_SIZE];           //!< Memory, erased (0xFF) by i2c_fake_reset().
+	uint16_t pointer;                            //!< Address counter.
+	uint64_t busyUntil;                          //!< End of the running write cycle in ns.
+	uint32_t writes;                             //!< Write cycles started.
+	uint32_t wraps;                              //!< Data bytes that rolled over to the start of their page.
+	uint32_t nacks;                              //!< Addressings not acknowledged during a write cycle.
+};
+
+/**State of the fake bus.
+ *
+ */
+struct i2c_fake {
+	struct ds3231_model rtc;                     //!< The slave at DS3231_MODEL_ADDRESS.
+	struct i2c_fake_eeprom eeprom;               //!< The slave at I2C_FAKE_EEPROM_ADDRESS
+	uint64_t now;                                //!< Bus time in ns.
+	uint64_t edge;                               //!< Time of the next second edge of the DS3231 in ns.
+	uint32_t ioctls;                             //!< I2C_RDWR calls on the bus.
+	uint32_t msgs;                               //!< Messages transferred.
+	uint32_t bytes;                              //!< Bytes transferred, including the address bytes.
+	int error;                                   //!< errno returned by the next I2C_RDWR instead of transferring, 0 for none.
+};
+
+extern struct i2c_fake i2c_fake;
+
+/**Resets the DS3231 to its power-on state, erases the EEPROM and clears the counters.
+ *
+ * @param[in]     now        Bus time in ns.
+ * @param[in]     edge       Time of the first second edge in ns, after now.
+ */
+void i2c_fake_reset(uint64_t now, uint64_t edge);
+
+/**Advances the bus time, ticking the DS3231 at every second edge passed.
+ *
+ * @param[in]     ns         Time to advance by in ns.
+ */
+void i2c_fake_advance(uint64_t ns);
+
+#endif /* I2C_FAKE_H_ */
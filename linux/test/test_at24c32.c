@@ -0,0 +1,202 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_at24c32.c
+ * @brief Tests of the AT24C32 record logger (at24c32.c) against the EEPROM of the fake bus.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "at24c32.h"
+#include "calendar.h"
+#include "i2c_fake.h"
+#include "twi_i2cdev.h"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define SLOTS_PER_PAGE (AT24C32_PAGE_SIZE / AT24C32_RECORD_SIZE)
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+/**Resets the fake bus with an erased EEPROM, and initializes the logger.
+ *
+ */
+static void setup(void)
+{
+	i2c_fake_reset(0, 1000000000ULL);
+	CHECK(TWI_master_open(I2C_FAKE_DEVICE));
+	CHECK(at24c32_init() == AT24C32_OK);
+	CHECK(at24c32_count() == 0);
+}
+
+/**Logs n records, each with a time stamp and payload derived from its number.
+ *
+ */
+static void log_records(uint16_t first, uint16_t n)
+{
+	struct time time_ = { .sec = 0, .min = 0, .hour = 0, .mday = 1, .mon = 1, .year = 120 };
+	uint8_t data[AT24C32_DATA_SIZE];
+
+	for (uint16_t i = first; i < first + n; i++)
+	{
+		time_.sec = i % 60;
+		time_.min = i / 60;
+		memset(data, i & 0xFF, sizeof(data));
+		CHECK(at24c32_log(&time_, data) == AT24C32_OK);
+	}
+}
+
+/**Checks that a record holds what log_records() logged as record number i.
+ *
+ */
+static bool record_is(const struct at24c32_record* record, uint16_t i)
+{
+	struct time time_ = { .sec = i % 60, .min = i / 60, .hour = 0, .mday = 1, .mon = 1, .year = 120 };
+
+	return (record->seq == i && record->timestamp == cal_to_epoch(&time_) && record->data[0] == (i & 0xFF) &&
+	        record->data[AT24C32_DATA_SIZE - 1] == (i & 0xFF));
+}
+
+/**Records are written one page at a time, and a partly written page is completed
+ * without rewriting or crossing into the next page.
+ */
+static void test_pages(void)
+{
+	struct at24c32_record record;
+	uint16_t slot;
+
+	setup();
+	log_records(0, SLOTS_PER_PAGE);
+	CHECK(i2c_fake.eeprom.writes == 1);
+
+	log_records(SLOTS_PER_PAGE, 1);
+	CHECK(i2c_fake.eeprom.writes == 1);
+	CHECK(at24c32_flush() == AT24C32_OK);
+	CHECK(i2c_fake.eeprom.writes == 2);
+	CHECK(at24c32_flush() == AT24C32_OK);
+	CHECK(i2c_fake.eeprom.writes == 2);
+
+	// The rest of the second page, then one record into the third
+	log_records(SLOTS_PER_PAGE + 1, SLOTS_PER_PAGE);
+	CHECK(at24c32_flush() == AT24C32_OK);
+	CHECK(i2c_fake.eeprom.writes == 4);
+	CHECK(i2c_fake.eeprom.wraps == 0);
+	CHECK(i2c_fake.eeprom.nacks > 0);            // Write cycles were waited for by ACK polling
+
+	CHECK(at24c32_count() == 2 * SLOTS_PER_PAGE + 1);
+	for (slot = 0; slot < at24c32_count(); slot++)
+	{
+		CHECK(at24c32_read(at24c32_count() - 1 - slot, &record) == AT24C32_OK);
+		CHECK(record_is(&record, slot));
+		CHECK(i2c_fake.eeprom.mem[slot * AT24C32_RECORD_SIZE] == slot);
+	}
+	CHECK(i2c_fake.eeprom.mem[slot * AT24C32_RECORD_SIZE] == 0xFF);
+	CHECK(at24c32_read(at24c32_count(), &record) == AT24C32_ERR_PARAM);
+}
+
+/**Once the EEPROM is full, the oldest records are overwritten.
+ *
+ */
+static void test_wrap(void)
+{
+	struct at24c32_record record;
+
+	setup();
+	log_records(0, AT24C32_RECORDS + 3);
+	CHECK(at24c32_flush() == AT24C32_OK);
+	CHECK(i2c_fake.eeprom.wraps == 0);
+
+	CHECK(at24c32_count() == AT24C32_RECORDS);
+	CHECK(at24c32_read(0, &record) == AT24C32_OK);
+	CHECK(record_is(&record, AT24C32_RECORDS + 2));
+	CHECK(at24c32_read(AT24C32_RECORDS - 1, &record) == AT24C32_OK);
+	CHECK(record_is(&record, 3));
+	CHECK(at24c32_read(AT24C32_RECORDS, &record) == AT24C32_ERR_PARAM);
+
+	// Slot 0 holds the first record of the second lap
+	CHECK(i2c_fake.eeprom.mem[0] == (AT24C32_RECORDS & 0xFF) && i2c_fake.eeprom.mem[1] == AT24C32_RECORDS >> 8);
+}
+
+/**After a reset, at24c32_init() finds the newest record and logging continues after it.
+ *
+ */
+static void test_recovery(void)
+{
+	static const uint16_t counts[] = { 1, SLOTS_PER_PAGE, 37, AT24C32_RECORDS - 1, AT24C32_RECORDS, AT24C32_RECORDS + 5 };
+	struct at24c32_record record;
+
+	for (uint8_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+	{
+		uint16_t n = counts[i];
+		uint16_t expected = (n < AT24C32_RECORDS) ? n : AT24C32_RECORDS;
+
+		setup();
+		log_records(0, n);
+		CHECK(at24c32_flush() == AT24C32_OK);
+
+		// Reset while the last page is still being written
+		CHECK(i2c_fake.now < i2c_fake.eeprom.busyUntil);
+		CHECK(at24c32_init() == AT24C32_OK);
+		CHECK(at24c32_count() == expected);
+		CHECK(at24c32_read(0, &record) == AT24C32_OK);
+		CHECK(record_is(&record, n - 1));
+		CHECK(at24c32_read(expected - 1, &record) == AT24C32_OK);
+		CHECK(record_is(&record, n - expected));
+
+		log_records(n, 1);
+		CHECK(at24c32_flush() == AT24C32_OK);
+		CHECK(at24c32_init() == AT24C32_OK);
+		CHECK(at24c32_read(0, &record) == AT24C32_OK);
+		CHECK(record_is(&record, n));
+		CHECK(at24c32_read(1, &record) == AT24C32_OK);
+		CHECK(record_is(&record, n - 1));
+	}
+}
+
+int main(void)
+{
+	test_pages();
+	test_wrap();
+	test_recovery();
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,225 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_calendar.c
+ * @brief Tests of the calendar arithmetic (calendar.c) on the host.
+ *
+ * Every day of 1900..2099 is checked against the C library (timegm() and gmtime()),
+ * and the arithmetic at the ends of its 2000..2099 range and across leap days.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "calendar.h"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define EPOCH_2000 946684800LL                   //!< 2000-01-01 00:00:00 in Unix time.
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+/**Makes a time from its fields.
+ *
+ */
+static struct time make(uint16_t year, uint8_t mon, uint8_t mday, uint8_t hour, uint8_t min, uint8_t sec)
+{
+	struct time time_ = { .sec = sec, .min = min, .hour = hour, .mday = mday, .mon = mon, .year = year - 1900 };
+
+	return (time_);
+}
+
+/**Checks that a time has the given fields.
+ *
+ */
+static bool is(const struct time* time_, uint16_t year, uint8_t mon, uint8_t mday, uint8_t hour, uint8_t min, uint8_t sec)
+{
+	return (time_->year == year - 1900 && time_->mon == mon && time_->mday == mday && time_->hour == hour &&
+	        time_->min == min && time_->sec == sec);
+}
+
+/**Validation, leap years and weekdays agree with the C library for every day.
+ *
+ */
+static void test_days(void)
+{
+	struct tm tm = { .tm_year = 0, .tm_mon = 0, .tm_mday = 1, .tm_hour = 12 };
+	time_t t = timegm(&tm);
+
+	for (uint16_t year = 1900; year <= 2099; year++)
+	{
+		uint16_t days = 0;
+
+		CHECK(cal_is_leap(year - 1900) == ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0));
+		for (uint8_t mon = 1; mon <= 12; mon++)
+		{
+			struct time time_ = make(year, mon, 0, 12, 0, 0);
+
+			CHECK(!cal_is_valid(&time_));
+			for (time_.mday = 1; time_.mday <= 31; time_.mday++)
+			{
+				gmtime_r(&t, &tm);
+				if (tm.tm_mon + 1 != mon)
+				{
+					// Past the end of the month
+					CHECK(!cal_is_valid(&time_));
+					break;
+				}
+				CHECK(cal_is_valid(&time_));
+				CHECK(cal_weekday(&time_) == tm.tm_wday + 1);
+				t += 86400;
+				days++;
+			}
+			CHECK(cal_days_in_month(year - 1900, mon) == time_.mday - 1);
+		}
+		CHECK(days == (cal_is_leap(year - 1900) ? 366 : 365));
+	}
+
+	struct time time_ = make(2000, 1, 1, 23, 59, 59);
+
+	CHECK(cal_is_valid(&time_));
+	time_.hour = 24;
+	CHECK(!cal_is_valid(&time_));
+	time_ = make(2000, 1, 1, 0, 60, 0);
+	CHECK(!cal_is_valid(&time_));
+	time_ = make(2000, 1, 1, 0, 0, 60);
+	CHECK(!cal_is_valid(&time_));
+	time_ = make(2000, 13, 1, 0, 0, 0);
+	CHECK(!cal_is_valid(&time_));
+	time_.year = 200;
+	time_.mon = 1;
+	CHECK(!cal_is_valid(&time_));
+}
+
+/**Conversion to and from seconds agrees with the C library over 2000..2099.
+ *
+ */
+static void test_epoch(void)
+{
+	struct time time_;
+	struct tm tm;
+
+	for (uint32_t day = 0; day < CAL_DAYS(99, 12, 31) + 1; day++)
+	{
+		uint32_t epoch = day * 86400UL + (day * 3607UL) % 86400;  // A different time of day each day
+		time_t t = EPOCH_2000 + epoch;
+
+		gmtime_r(&t, &tm);
+		cal_from_epoch(epoch, &time_);
+		CHECK(is(&time_, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec));
+		CHECK(time_.wday == tm.tm_wday + 1);
+		CHECK(time_.twelveHour == tm.tm_hour % 12 && time_.am == (tm.tm_hour < 12));
+		CHECK(cal_to_epoch(&time_) == epoch);
+		if (failures > 20)
+		{
+			return;
+		}
+	}
+}
+
+/**The ends of the range and the leap days.
+ *
+ */
+static void test_edges(void)
+{
+	struct time first = make(2000, 1, 1, 0, 0, 0);
+	struct time last = make(2099, 12, 31, 23, 59, 59);
+	struct time time_;
+
+	CHECK(cal_to_epoch(&first) == 0);
+	CHECK(cal_to_epoch(&last) == (CAL_DAYS(99, 12, 31) + 1) * 86400UL - 1);
+	CHECK(CAL_DAYS(99, 12, 31) == 36524);
+	cal_from_epoch(0, &time_);
+	CHECK(is(&time_, 2000, 1, 1, 0, 0, 0) && time_.wday == 7);
+	cal_from_epoch(cal_to_epoch(&last), &time_);
+	CHECK(is(&time_, 2099, 12, 31, 23, 59, 59) && time_.wday == 5);
+
+	// 2000 is a leap year (divisible by 400), so is 2096; 1900 and 2099 are not
+	time_ = make(2000, 2, 29, 0, 0, 0);
+	CHECK(cal_is_valid(&time_));
+	time_ = make(2096, 2, 29, 0, 0, 0);
+	CHECK(cal_is_valid(&time_));
+	time_ = make(1900, 2, 29, 0, 0, 0);
+	CHECK(!cal_is_valid(&time_));
+	time_ = make(2099, 2, 29, 0, 0, 0);
+	CHECK(!cal_is_valid(&time_));
+
+	time_ = make(2000, 2, 28, 23, 59, 59);
+	cal_add_seconds(&time_, 1);
+	CHECK(is(&time_, 2000, 2, 29, 0, 0, 0));
+	cal_add_days(&time_, 1);
+	CHECK(is(&time_, 2000, 3, 1, 0, 0, 0));
+	cal_add_minutes(&time_, -1);
+	CHECK(is(&time_, 2000, 2, 29, 23, 59, 0));
+
+	time_ = make(2024, 2, 29, 12, 0, 0);
+	cal_add_days(&time_, 365);
+	CHECK(is(&time_, 2025, 2, 28, 12, 0, 0));
+	cal_add_days(&time_, -366);
+	CHECK(is(&time_, 2024, 2, 28, 12, 0, 0));
+	time_ = make(2024, 2, 29, 12, 0, 0);
+	cal_add_days(&time_, 4 * 365 + 1);
+	CHECK(is(&time_, 2028, 2, 29, 12, 0, 0) && time_.wday == 3);
+
+	time_ = make(2000, 1, 1, 0, 0, 30);
+	cal_add_seconds(&time_, -30);
+	CHECK(is(&time_, 2000, 1, 1, 0, 0, 0));
+	time_ = make(2099, 12, 31, 23, 0, 0);
+	cal_add_minutes(&time_, 59);
+	CHECK(is(&time_, 2099, 12, 31, 23, 59, 0));
+	time_ = make(2098, 12, 31, 0, 0, 0);
+	cal_add_days(&time_, 1);
+	CHECK(is(&time_, 2099, 1, 1, 0, 0, 0));
+
+	CHECK(cal_diff(&last, &first) == (int32_t)cal_to_epoch(&last));
+	CHECK(cal_diff(&first, &last) == -(int32_t)cal_to_epoch(&last));
+	time_ = make(2024, 3, 1, 0, 0, 0);
+	first = make(2024, 2, 28, 0, 0, 0);
+	CHECK(cal_diff(&time_, &first) == 2 * 86400);
+}
+
+int main(void)
+{
+	test_days();
+	test_epoch();
+	test_edges();
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
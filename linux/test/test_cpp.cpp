@@ -0,0 +1,290 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_cpp.cpp
+ * @brief Tests of the header-only C++ driver (ds3231.hpp) against the C driver.
+ *
+ * Each operation is run through both drivers on a freshly reset fake bus, and the
+ * register files and bus traffic afterwards are compared.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ds3231.hpp"
+
+extern "C" {
+#include "i2c_fake.h"
+#include "twi_i2cdev.h"
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+typedef ds3231::DS3231<> RTC;
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+/**Resets the fake bus and reopens it.
+ *
+ */
+static void setup(void)
+{
+	i2c_fake_reset(0, 1000000000ULL);
+	TWI_master_open(I2C_FAKE_DEVICE);
+	// Both drivers start from 24-hour mode with the oscillator running
+	i2c_fake.rtc.regs[0x0F] = 0x00;
+	CHECK(ds3231_init(DS3231_CTR_INTCN, 0) == DS3231_OK);
+	i2c_fake.ioctls = 0;
+	i2c_fake.bytes = 0;
+}
+
+/**The state of the fake bus after an operation.
+ *
+ */
+struct outcome {
+	uint8_t regs[DS3231_MODEL_REGS];
+	uint32_t ioctls;
+	uint32_t bytes;
+};
+
+static struct outcome outcome(void)
+{
+	struct outcome o;
+
+	memcpy(o.regs, i2c_fake.rtc.regs, sizeof(o.regs));
+	o.ioctls = i2c_fake.ioctls;
+	o.bytes = i2c_fake.bytes;
+
+	return (o);
+}
+
+/**Compares the register files and bus traffic of both drivers.
+ *
+ */
+static void compare(const struct outcome& c, const struct outcome& cpp, int line)
+{
+	check(memcmp(c.regs, cpp.regs, sizeof(c.regs)) == 0, "registers differ", line);
+	check(cpp.ioctls <= c.ioctls, "more transactions than the C driver", line);
+	check(cpp.bytes <= c.bytes, "more bytes than the C driver", line);
+}
+
+/**Times read in either hour mode decode to the same hour.
+ *
+ */
+static void test_get_time(void)
+{
+	static const uint8_t hours[] = { 0x00, 0x13, 0x23, 0x52, 0x72, 0x41, 0x61 };
+	struct time c;
+	struct time cpp;
+	uint8_t hour = 0, min = 0, sec = 0;
+
+	for (uint8_t i = 0; i < sizeof(hours); i++)
+	{
+		setup();
+		i2c_fake.rtc.regs[0] = 0x30;
+		i2c_fake.rtc.regs[1] = 0x45;
+		i2c_fake.rtc.regs[2] = hours[i];
+		i2c_fake.rtc.regs[5] = 0x82;
+		i2c_fake.rtc.regs[6] = 0x24;
+
+		CHECK(ds3231_get_time(&c) == DS3231_OK);
+		CHECK(RTC::get_time(&cpp) == DS3231_OK);
+		if (hours[i] & 0x40)
+		{
+			// The C driver leaves hour to ds3231_12h_translate() in 12-hour mode
+			c.hour = c.twelveHour + (c.am ? 0 : 12);
+		}
+		CHECK(c.sec == cpp.sec && c.min == cpp.min && c.hour == cpp.hour);
+		CHECK(c.wday == cpp.wday && c.mday == cpp.mday && c.mon == cpp.mon && c.year == cpp.year);
+		CHECK(i2c_fake.ioctls == 2);
+
+		CHECK(RTC::get_time_s(&hour, &min, &sec) == DS3231_OK);
+		CHECK(hour == c.hour && min == c.min && sec == c.sec);
+	}
+}
+
+/**Setting the time writes the same registers as the C driver in 24-hour mode.
+ *
+ */
+static void test_set_time(void)
+{
+	struct time time_ = { .sec = 5, .min = 4, .hour = 23, .mday = 29, .mon = 2, .year = 124 };
+	struct outcome c;
+
+	setup();
+	CHECK(ds3231_set_time(&time_) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK(RTC::set_time(&time_) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+	CHECK(time_.wday == cal_weekday(&time_));
+
+	setup();
+	CHECK(ds3231_set_time_s(12, 59, 58) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK(RTC::set_time_s(12, 59, 58) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+}
+
+/**Alarms are encoded from the compile-time mode as the C driver encodes them at run time.
+ *
+ */
+static void test_set_alarm(void)
+{
+	struct outcome c;
+
+	setup();
+	CHECK(ds3231_set_alarm_s(0, 14, 30, 15, ALARM_1, ALARM_HOUR_M, true) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK((RTC::set_alarm<ALARM_1, ALARM_HOUR_M>(0, 14, 30, 15, true)) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+
+	setup();
+	CHECK(ds3231_set_alarm_s(3, 7, 0, 0, ALARM_1, ALARM_WDAY_M, true) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK((RTC::set_alarm<ALARM_1, ALARM_WDAY_M>(3, 7, 0, 0, true)) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+
+	setup();
+	CHECK(ds3231_set_alarm_s(0, 0, 0, 0, ALARM_2, ALARM_MIN, true) == DS3231_OK);
+	CHECK(ds3231_set_alarm_s(31, 23, 59, 0, ALARM_2, ALARM_MDAY_M, false) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK((RTC::set_alarm<ALARM_2, ALARM_MIN>(0, 0, 0, 0, true)) == DS3231_OK);
+	CHECK((RTC::set_alarm<ALARM_2, ALARM_MDAY_M>(31, 23, 59, 0, false)) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+}
+
+/**Output control and alarm flags change the same bits as the C driver.
+ *
+ */
+static void test_control(void)
+{
+	struct outcome c;
+	bool active;
+
+	setup();
+	CHECK(ds3231_SQW_enable(true) == DS3231_OK);
+	CHECK(ds3231_osc32kHz_enable(true) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK(RTC::SQW_enable(true) == DS3231_OK);
+	CHECK(RTC::osc32kHz_enable(true) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+
+	setup();
+	CHECK(ds3231_SQW_enable(false) == DS3231_OK);
+	CHECK(ds3231_osc32kHz_enable(false) == DS3231_OK);
+	c = outcome();
+	setup();
+	CHECK(RTC::SQW_enable(false) == DS3231_OK);
+	CHECK(RTC::osc32kHz_enable(false) == DS3231_OK);
+	compare(c, outcome(), __LINE__);
+
+	setup();
+	i2c_fake.rtc.regs[0x0F] = DS3231_STS_A1F | DS3231_STS_A2F;
+	CHECK(RTC::check_alarm<ALARM_2>(&active) == DS3231_OK);
+	CHECK(active);
+	CHECK(RTC::clear_alarm<ALARM_2>() == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0x0F] == DS3231_STS_A1F);
+	CHECK(RTC::check_alarm<ALARM_2>(&active) == DS3231_OK);
+	CHECK(!active);
+	CHECK(RTC::check_alarm<ALARM_1>(&active) == DS3231_OK);
+	CHECK(active);
+}
+
+/**init() writes "Control" and "Status" only if they differ, and reports a stopped oscillator.
+ *
+ */
+static void test_init(void)
+{
+	struct outcome c;
+
+	setup();
+	i2c_fake.rtc.regs[0x0F] = DS3231_STS_OSF;
+	CHECK(ds3231_init(DS3231_CTR_BBSQW, DS3231_STS_EN32KHZ) == DS3231_TIME_INVALID);
+	c = outcome();
+	setup();
+	i2c_fake.rtc.regs[0x0F] = DS3231_STS_OSF;
+	CHECK(RTC::init(DS3231_CTR_BBSQW, DS3231_STS_EN32KHZ) == DS3231_TIME_INVALID);
+	compare(c, outcome(), __LINE__);
+
+	CHECK(RTC::init(DS3231_CTR_BBSQW, DS3231_STS_EN32KHZ) == DS3231_TIME_INVALID);
+	CHECK(i2c_fake.ioctls == 3);
+}
+
+/**The temperature and the transmission errors are reported as by the C driver.
+ *
+ */
+static void test_result(void)
+{
+	int8_t i = 0;
+	uint8_t f = 0;
+	struct time time_;
+
+	setup();
+	i2c_fake.rtc.regs[0x11] = 0xE7;
+	i2c_fake.rtc.regs[0x12] = 0xC0;
+	CHECK(RTC::get_temp_int(&i, &f) == DS3231_OK);
+	CHECK(i == -25 && f == 75);
+
+	setup();
+	i2c_fake.error = ENXIO;
+	CHECK(RTC::get_time(&time_) == DS3231_ERR_NACK);
+	i2c_fake.error = EIO;
+	CHECK(RTC::set_time_s(1, 2, 3) == DS3231_ERR_BUS);
+	i2c_fake.error = EINVAL;
+	CHECK(RTC::SQW_enable(true) == DS3231_ERR_FAULT);
+}
+
+int main(void)
+{
+	test_init();
+	test_get_time();
+	test_set_time();
+	test_set_alarm();
+	test_control();
+	test_result();
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
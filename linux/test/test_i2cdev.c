@@ -0,0 +1,399 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_i2cdev.c
+ * @brief Tests of the Linux i2c-dev backend against the in-process fake bus.
+ *
+ * Usage: test_i2cdev [-b iterations] [-t trace]
+ *
+ * Runs the tests, then with -b prints the latency of every API call through the
+ * backend, with the I2C_RDWR calls and the modelled bus time per call. With -t every
+ * API is called once on a freshly reset DS3231 while recording a bus trace, to be
+ * compared against the baseline with twi_trace.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ds3231.h"
+#include "i2c_fake.h"
+#include "twi_i2cdev.h"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define BENCH(name, call) \
+	do \
+	{ \
+		uint32_t ioctls = i2c_fake.ioctls; \
+		uint64_t bus = i2c_fake.now; \
+		struct timespec start; \
+		struct timespec end; \
+		TWI_trace_mark(name); \
+		clock_gettime(CLOCK_MONOTONIC, &start); \
+		for (long i = 0; i < iterations; i++) \
+		{ \
+			(void)(call); \
+		} \
+		clock_gettime(CLOCK_MONOTONIC, &end); \
+		if (report) \
+		{ \
+			printf("%-36s %10.0f %8.2f %8.1f\n", name, \
+			       ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / iterations, \
+			       (double)(i2c_fake.ioctls - ioctls) / iterations, (i2c_fake.now - bus) / 1e3 / iterations); \
+		} \
+	} while (0)
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+/**Resets the fake bus and reopens it.
+ *
+ */
+static void setup(void)
+{
+	i2c_fake_reset(0, 1000000000ULL);
+	CHECK(TWI_master_open(I2C_FAKE_DEVICE));
+}
+
+/**A pointer write and the following read are issued as one combined transaction.
+ *
+ */
+static void test_combined_read(void)
+{
+	struct time time_;
+
+	setup();
+	i2c_fake.rtc.regs[0] = 0x30;
+	i2c_fake.rtc.regs[1] = 0x45;
+	i2c_fake.rtc.regs[2] = 0x13;
+
+	CHECK(ds3231_get_time(&time_) == DS3231_OK);
+	CHECK(i2c_fake.ioctls == 1);
+	CHECK(i2c_fake.msgs == 2);
+	CHECK(i2c_fake.bytes == 2 + 1 + 7);
+	CHECK(time_.sec == 30 && time_.min == 45 && time_.hour == 13);
+}
+
+/**Every write is sent at once as one message, TWI_write_read() as one combined
+ * transaction.
+ */
+static void test_write(void)
+{
+	struct time time_ = { .sec = 5, .min = 4, .hour = 3, .mday = 2, .mon = 1, .year = 120, .wday = 4 };
+	uint8_t pointer[2] = { DS3231_ADDRESS << TWI_ADR_BITS, 0x0E };
+	uint8_t write[3] = { DS3231_ADDRESS << TWI_ADR_BITS, 0x07, 0x12 };
+	uint8_t read[3] = { DS3231_ADDRESS << TWI_ADR_BITS, 0x07 };
+
+	setup();
+	CHECK(ds3231_set_time(&time_) == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0] == 0x05 && i2c_fake.rtc.regs[2] == 0x03 && i2c_fake.rtc.regs[6] == 0x20);
+
+	setup();
+	CHECK(TWI_start_transceiver_with_data(pointer, sizeof(pointer)));
+	CHECK(i2c_fake.ioctls == 1 && i2c_fake.msgs == 1);
+	CHECK(i2c_fake.rtc.pointer == 0x0E);
+	CHECK(TWI_start_transceiver_with_data(write, sizeof(write)));
+	CHECK(i2c_fake.ioctls == 2 && i2c_fake.msgs == 2);
+	CHECK(i2c_fake.rtc.regs[0x07] == 0x12);
+
+	CHECK(TWI_write_read(read, 2, 2));
+	CHECK(i2c_fake.ioctls == 3 && i2c_fake.msgs == 4);
+	CHECK(read[1] == 0x12 && read[2] == i2c_fake.rtc.regs[0x08]);
+	CHECK(i2c_fake.rtc.pointer == 0x09);
+}
+
+/**A warm ds3231_init() is one transaction; the hour mode is read before the first
+ * time set without a time read.
+ */
+static void test_init(void)
+{
+	setup();
+	i2c_fake.rtc.regs[2] = 0x41;                 // 1 AM in 12-hour mode
+
+	CHECK(ds3231_init(DS3231_CTR_INTCN, 0) == DS3231_TIME_INVALID);
+	i2c_fake.ioctls = 0;
+	CHECK(ds3231_init(DS3231_CTR_INTCN, 0) == DS3231_TIME_INVALID);
+	CHECK(i2c_fake.ioctls == 1);
+
+	CHECK(ds3231_set_time_s(13, 0, 0) == DS3231_OK);
+	CHECK(i2c_fake.ioctls == 3);
+	CHECK(i2c_fake.rtc.regs[2] == 0x61);         // 1 PM
+	CHECK(ds3231_set_time_s(14, 0, 0) == DS3231_OK);
+	CHECK(i2c_fake.ioctls == 4);
+	CHECK(i2c_fake.rtc.regs[2] == 0x62);
+}
+
+/**Failed transfers report the TWI error matching the errno of I2C_RDWR.
+ *
+ */
+static void test_errors(void)
+{
+	uint8_t read[2] = { (0x50 << TWI_ADR_BITS) | (1 << TWI_READ_BIT), 0 };
+	uint8_t write[3] = { DS3231_ADDRESS << TWI_ADR_BITS, 0x07, 0x12 };
+	static const struct {
+		int error;
+		uint8_t state;
+	} errors[] = {
+		{ ENXIO, TWI_NO_ACK_ON_ADDRESS },
+		{ EREMOTEIO, TWI_NO_ACK_ON_ADDRESS },
+		{ EAGAIN, TWI_UE_DATA_COL },
+		{ EINVAL, TWI_DATA_OUT_OF_BOUND },
+		{ EIO, TWI_MISSING_START_CON },
+		{ ETIMEDOUT, TWI_MISSING_START_CON },
+	};
+
+	setup();
+	CHECK(!TWI_start_transceiver_with_data(read, sizeof(read)));
+	CHECK(TWI_get_state_info() == TWI_NO_ACK_ON_ADDRESS);
+
+	for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++)
+	{
+		i2c_fake.error = errors[i].error;
+		CHECK(!TWI_start_transceiver_with_data(write, sizeof(write)));
+		CHECK(TWI_get_state_info() == errors[i].state);
+	}
+
+	CHECK(!TWI_master_open("/nonexistent/i2c-0"));
+	CHECK(!TWI_start_transceiver_with_data(write, sizeof(write)));
+	CHECK(TWI_get_state_info() == TWI_MISSING_START_CON);
+}
+
+/**A read retried after losing arbitration is sent with its pointer write again.
+ *
+ */
+static void test_retry(void)
+{
+	struct time time_;
+
+	setup();
+	i2c_fake.rtc.regs[0] = 0x30;
+	i2c_fake.rtc.pointer = 0x0E;
+
+	i2c_fake.error = EAGAIN;
+	CHECK(ds3231_get_time(&time_) == DS3231_OK);
+	CHECK(i2c_fake.ioctls == 2);
+	CHECK(i2c_fake.msgs == 2);
+	CHECK(time_.sec == 30);
+
+	i2c_fake.error = EIO;
+	CHECK(ds3231_get_time(&time_) == DS3231_OK);
+	CHECK(i2c_fake.ioctls == 4);
+	CHECK(time_.sec == 30);
+}
+
+/**Switching the hour mode is refused in the last second of an hour, and succeeds after it.
+ *
+ */
+static void test_12h_rollover(void)
+{
+	setup();
+	i2c_fake.rtc.regs[0] = 0x59;
+	i2c_fake.rtc.regs[1] = 0x59;
+	i2c_fake.rtc.regs[2] = 0x13;
+	CHECK(ds3231_set_12h_mode(true) == DS3231_ERR_ROLLOVER);
+	CHECK(i2c_fake.ioctls == 1);
+	CHECK(i2c_fake.rtc.regs[2] == 0x13);
+
+	i2c_fake_advance(i2c_fake.edge - i2c_fake.now);
+	CHECK(ds3231_set_12h_mode(true) == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[2] == 0x62);         // 2 PM
+}
+
+/**Polling a busy flag ends when it clears, or after DS3231_POLL_LIMIT reads.
+ *
+ */
+static void test_poll(void)
+{
+	setup();
+	i2c_fake.rtc.regs[0x0F] = DS3231_STS_BSY;    // An automatic conversion ending in 1 ms
+	i2c_fake.rtc.convEnd = i2c_fake.rtc.now + 1000;
+	CHECK(ds3231_force_temp_conversion(0) == DS3231_OK);
+	CHECK(i2c_fake.ioctls > 1 && i2c_fake.ioctls < DS3231_POLL_LIMIT);
+	CHECK(i2c_fake.rtc.regs[0x0E] & DS3231_CTR_CONV);
+
+	setup();
+	i2c_fake.rtc.regs[0x0F] = DS3231_STS_BSY;    // A conversion that never ends
+	i2c_fake.rtc.convEnd = UINT64_MAX;
+	CHECK(ds3231_force_temp_conversion(1) == DS3231_ERR_TIMEOUT);
+	CHECK(i2c_fake.ioctls == DS3231_POLL_LIMIT);
+	CHECK(!(i2c_fake.rtc.regs[0x0E] & DS3231_CTR_CONV));
+}
+
+#ifdef DS3231_BATCH
+/**In a batch, alarm flags are read from the DS3231, and only those cleared in the batch
+ * are written as 0 by the commit.
+ */
+static void test_batch_alarm(void)
+{
+	bool active;
+
+	setup();
+	i2c_fake.rtc.regs[0x0F] = 0x00;
+	ds3231_begin_update();
+	CHECK(ds3231_osc32kHz_enable(true) == DS3231_OK);
+	i2c_fake.rtc.regs[0x0F] |= DS3231_STS_A1F;   // Raised after the registers were buffered
+	CHECK(ds3231_check_alarm(&active, ALARM_1) == DS3231_OK);
+	CHECK(active);
+	CHECK(ds3231_commit() == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0x0F] == (DS3231_STS_EN32KHZ | DS3231_STS_A1F));
+
+	ds3231_begin_update();
+	CHECK(ds3231_osc32kHz_enable(false) == DS3231_OK);
+	i2c_fake.rtc.regs[0x0F] |= DS3231_STS_A2F;
+	CHECK(ds3231_clear_alarm(ALARM_1) == DS3231_OK);
+	CHECK(ds3231_check_alarm(&active, ALARM_1) == DS3231_OK);
+	CHECK(active);                               // Not cleared before the commit
+	CHECK(ds3231_commit() == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0x0F] == DS3231_STS_A2F);
+
+	ds3231_begin_update();
+	CHECK(ds3231_clear_alarm(ALARM_2) == DS3231_OK);
+	CHECK(ds3231_commit() == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0x0F] == 0x00);
+
+	ds3231_begin_update();
+	CHECK(ds3231_osc32kHz_enable(false) == DS3231_OK);
+	i2c_fake.rtc.regs[0x0F] |= DS3231_STS_A1F;   // Raised after the registers were buffered, then cleared
+	CHECK(ds3231_clear_alarm(ALARM_1) == DS3231_OK);
+	CHECK(ds3231_commit() == DS3231_OK);
+	CHECK(i2c_fake.rtc.regs[0x0F] == 0x00);
+}
+#endif
+
+/**Calls every API the given number of times, printing their latency if report is set.
+ *
+ */
+static void run_apis(long iterations, bool report)
+{
+	struct time time_ = { .sec = 30, .min = 45, .hour = 13, .mday = 5, .mon = 3, .year = 120, .wday = 5 };
+	struct time alarms[2];
+	uint8_t modes[2];
+	bool intrpts[2];
+	uint8_t mode;
+	bool intrpt;
+	bool active;
+	uint8_t hour, min, sec, mday, mon, year, day;
+	int8_t temp;
+	uint8_t frac;
+
+	setup();
+	if (report)
+	{
+		printf("%-36s %10s %8s %8s\n", "api", "ns", "ioctls", "bus_us");
+	}
+	BENCH("ds3231_init", ds3231_init(DS3231_CTR_INTCN, 0));
+	BENCH("ds3231_init (warm)", ds3231_init(DS3231_CTR_INTCN, 0));
+	BENCH("ds3231_set_time", ds3231_set_time(&time_));
+	BENCH("ds3231_set_time_s", ds3231_set_time_s(13, 45, 30));
+	BENCH("ds3231_get_time", ds3231_get_time(&time_));
+	BENCH("ds3231_get_fields", ds3231_get_fields(&time_, DS3231_F_TIME));
+	BENCH("ds3231_get_time_s", ds3231_get_time_s(&hour, &min, &sec));
+	BENCH("ds3231_get_date_s", ds3231_get_date_s(&mday, &mon, &year, &hour, &min, &sec));
+	BENCH("ds3231_get_temp_int", ds3231_get_temp_int(&temp, &frac));
+	BENCH("ds3231_force_temp_conversion", ds3231_force_temp_conversion(0));
+	BENCH("ds3231_SQW_enable", ds3231_SQW_enable(false));
+	BENCH("ds3231_osc32kHz_enable", ds3231_osc32kHz_enable(false));
+	BENCH("ds3231_set_alarm", ds3231_set_alarm(&time_, ALARM_1, ALARM_HOUR_M, true));
+	BENCH("ds3231_set_alarm_s", ds3231_set_alarm_s(0, 14, 0, 0, ALARM_2, ALARM_HOUR_M, false));
+	BENCH("ds3231_get_alarm", ds3231_get_alarm(&time_, ALARM_1, &mode, &intrpt));
+	BENCH("ds3231_get_alarm_s", ds3231_get_alarm_s(&day, &hour, &min, &sec, ALARM_2, &mode, &intrpt));
+	BENCH("ds3231_get_alarms", ds3231_get_alarms(alarms, modes, intrpts));
+	BENCH("ds3231_check_alarm", ds3231_check_alarm(&active, ALARM_1));
+	BENCH("ds3231_clear_alarm", ds3231_clear_alarm(ALARM_1));
+	BENCH("ds3231_reset_alarm", ds3231_reset_alarm(ALARM_2));
+	BENCH("ds3231_set_12h_mode", ds3231_set_12h_mode(false));
+#ifdef DS3231_BATCH
+	BENCH("ds3231_begin_update..ds3231_commit", (ds3231_begin_update(), ds3231_set_time(&time_),
+	      ds3231_set_alarm(&time_, ALARM_1, ALARM_MIN_M, true), ds3231_SQW_enable(false), ds3231_commit()));
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	long iterations = 0;
+	const char* trace = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:t:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'b':
+				iterations = atol(optarg);
+				break;
+			case 't':
+				trace = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-b iterations] [-t trace]\n", argv[0]);
+				return (2);
+		}
+	}
+
+	test_combined_read();
+	test_write();
+	test_init();
+	test_errors();
+	test_retry();
+	test_12h_rollover();
+	test_poll();
+#ifdef DS3231_BATCH
+	test_batch_alarm();
+#endif
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	if (trace)
+	{
+		if (!TWI_trace_open(trace))
+		{
+			perror(trace);
+			return (EXIT_FAILURE);
+		}
+		run_apis(1, false);
+		TWI_trace_open(NULL);
+	}
+
+	if (iterations > 0)
+	{
+		run_apis(iterations, true);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,111 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_shm.c
+ * @brief Test of the ds3231_shm reference clock daemon on the fake bus and clock.
+ *
+ * Runs the daemon for a few seconds of bus time against a DS3231 whose second edges
+ * lag the system seconds by EDGE_PHASE, and checks the last published sample against
+ * the true edge.
+ */
+
+#define main ds3231_shm_main
+#include "ds3231_shm.c"
+#undef main
+
+#include "fake_clock.h"
+#include "i2c_fake.h"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+#define NS_PER_SEC 1000000000LL
+#define UNIT       9                             //!< SHM unit used by the test.
+#define EPOCH      946684800LL                   //!< 2000-01-01 00:00:00 UTC, the power-on time of the DS3231 model.
+#define EDGE_PHASE 432100000LL                   //!< Delay of the DS3231 second edges after the system seconds in ns.
+#define START      100000000LL                   //!< Time the daemon is started at after EPOCH in ns.
+#define RUN        5500000000LL                  //!< Time the daemon runs for in ns.
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	char* argv[] = { "ds3231_shm", "-d", I2C_FAKE_DEVICE, "-u", "9", NULL };
+	int id = shmget(SHM_KEY_BASE + UNIT, sizeof(struct shmTime), 0);
+	struct shmTime* shm;
+	long long receive;
+	long long error;
+	int samples;
+
+	if (id >= 0)
+	{
+		shmctl(id, IPC_RMID, NULL);              // Left behind by an earlier run
+	}
+
+	i2c_fake_reset(EPOCH * NS_PER_SEC + START, EPOCH * NS_PER_SEC + EDGE_PHASE);
+	fake_clock_end = EPOCH * NS_PER_SEC + START + RUN;
+	CHECK(ds3231_shm_main(5, argv) == EXIT_SUCCESS);
+
+	id = shmget(SHM_KEY_BASE + UNIT, sizeof(struct shmTime), 0);
+	shm = (id >= 0) ? shmat(id, NULL, 0) : (void*)-1;
+	if (shm == (void*)-1)
+	{
+		perror("shm");
+		return (EXIT_FAILURE);
+	}
+
+	// One sample per edge, the last one at EPOCH + 5 s + EDGE_PHASE when the DS3231 turns to 00:00:06
+	samples = (START + RUN - EDGE_PHASE) / NS_PER_SEC + 1;
+	receive = shm->receiveTimeStampSec * NS_PER_SEC + shm->receiveTimeStampNSec;
+	error = receive - ((EPOCH + samples - 1) * NS_PER_SEC + EDGE_PHASE);
+
+	CHECK(shm->valid);
+	CHECK(shm->mode == 1);
+	CHECK(shm->count == 2 * samples);
+	CHECK(shm->clockTimeStampSec == EPOCH + samples);
+	CHECK(shm->clockTimeStampNSec == 0);
+	CHECK(shm->receiveTimeStampUSec == (int)(shm->receiveTimeStampNSec / 1000));
+	CHECK(shm->precision <= -9);
+	CHECK(llabs(error) <= (NS_PER_SEC >> -shm->precision));
+	printf("%d samples, last edge error %lld ns, precision 2^%d s\n", shm->count / 2, error, shm->precision);
+
+	shmdt(shm);
+	shmctl(id, IPC_RMID, NULL);
+
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2017 Valters Melnalksnis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**@file test_tz.c
+ * @brief Tests of the time zone conversion (tz.c) on the host.
+ *
+ * The transitions built by the TZ_*_YEAR macros are checked against dates found
+ * with cal_weekday(), and the offsets on both sides of every edge, outside the
+ * table and from the cached interval.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "calendar.h"
+#include "tz.h"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static int failures;
+
+static void check(bool ok, const char* condition, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, condition);
+		failures++;
+	}
+}
+
+/**Gets the instant of a Sunday of a month, searching with cal_weekday().
+ *
+ * @param[in]     year       Years since 1900.
+ * @param[in]     mon        Month [1;12].
+ * @param[in]     n          Which Sunday [1;4], or 0 for the last one.
+ * @param[in]     hour       Hour of the day in UTC.
+ */
+static uint32_t sunday(uint8_t year, uint8_t mon, uint8_t n, uint8_t hour)
+{
+	struct time time_ = { .hour = hour, .mon = mon, .year = year };
+	uint8_t found = 0;
+
+	for (time_.mday = 1; time_.mday <= cal_days_in_month(year, mon); time_.mday++)
+	{
+		if (cal_weekday(&time_) == 1 && (++found == n || (n == 0 && time_.mday + 7 > cal_days_in_month(year, mon))))
+		{
+			break;
+		}
+	}
+
+	return (cal_to_epoch(&time_));
+}
+
+/**The offset changes exactly at a transition.
+ *
+ */
+static void check_edge(struct tz* zone, uint32_t at, int32_t before, int32_t after, int line)
+{
+	check(tz_offset(zone, at - 1) == before, "offset before the transition", line);
+	check(tz_offset(zone, at) == after, "offset at the transition", line);
+	check(tz_offset(zone, at - 1) == before, "offset before the transition, again", line);
+}
+
+/**EU transitions are at 01:00 UTC on the last Sundays of March and October.
+ *
+ */
+static void test_eu(void)
+{
+	static const uint32_t transitions[] PROGMEM = { TZ_EU_YEAR(0), TZ_EU_YEAR(24), TZ_EU_YEAR(25), TZ_EU_YEAR(99) };
+	static struct tz riga = TZ_ZONE(transitions, 120, 60);
+	struct time utc = { .sec = 59, .min = 59, .hour = 0, .mday = 26, .mon = 10, .year = 125 };
+	struct time local;
+
+	CHECK(transitions[0] == sunday(100, 3, 0, 1) && transitions[1] == sunday(100, 10, 0, 1));
+	CHECK(transitions[2] == sunday(124, 3, 0, 1) && transitions[3] == sunday(124, 10, 0, 1));
+	CHECK(transitions[4] == sunday(125, 3, 0, 1) && transitions[5] == sunday(125, 10, 0, 1));
+	CHECK(transitions[6] == sunday(199, 3, 0, 1) && transitions[7] == sunday(199, 10, 0, 1));
+
+	for (uint8_t i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i += 2)
+	{
+		check_edge(&riga, transitions[i], 7200, 10800, __LINE__);
+		check_edge(&riga, transitions[i + 1], 10800, 7200, __LINE__);
+		CHECK(tz_is_dst(&riga, transitions[i]) && !tz_is_dst(&riga, transitions[i + 1]));
+	}
+
+	// The local hour 03:00..03:59 repeats when DST ends
+	tz_localtime(&riga, &utc, &local);
+	CHECK(local.hour == 3 && local.min == 59 && local.sec == 59 && local.mday == 26);
+	utc.hour = 1;
+	utc.min = 0;
+	utc.sec = 0;
+	tz_localtime(&riga, &utc, &local);
+	CHECK(local.hour == 3 && local.min == 0 && local.sec == 0 && local.mday == 26);
+}
+
+/**US transitions are at 02:00 local time on the second Sunday of March and the first of November.
+ *
+ */
+static void test_us(void)
+{
+	static const uint32_t transitions[] PROGMEM = { TZ_US_YEAR(0, -5), TZ_US_YEAR(25, -5), TZ_US_YEAR(99, -5) };
+	static struct tz newYork = TZ_ZONE(transitions, -300, 60);
+	struct time utc = { .sec = 0, .min = 30, .hour = 4, .mday = 9, .mon = 3, .year = 125 };
+	struct time local;
+
+	CHECK(transitions[0] == sunday(100, 3, 2, 7) && transitions[1] == sunday(100, 11, 1, 6));
+	CHECK(transitions[2] == sunday(125, 3, 2, 7) && transitions[3] == sunday(125, 11, 1, 6));
+	CHECK(transitions[4] == sunday(199, 3, 2, 7) && transitions[5] == sunday(199, 11, 1, 6));
+
+	for (uint8_t i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i += 2)
+	{
+		check_edge(&newYork, transitions[i], -18000, -14400, __LINE__);
+		check_edge(&newYork, transitions[i + 1], -14400, -18000, __LINE__);
+	}
+
+	// A negative offset crosses midnight back to the previous day
+	tz_localtime(&newYork, &utc, &local);
+	CHECK(local.hour == 23 && local.min == 30 && local.mday == 8 && local.mon == 3);
+	CHECK(tz_to_local(&newYork, transitions[2]) == transitions[2] - 14400);
+}
+
+/**Before the first and after the last transition standard time applies.
+ *
+ */
+static void test_bounds(void)
+{
+	static const uint32_t transitions[] PROGMEM = { TZ_EU_YEAR(30) };
+	static const uint32_t empty[1] PROGMEM = { 0 };
+	static struct tz zone = TZ_ZONE(transitions, 60, 60);
+	struct tz none = { empty, 0, 3600, 3600, 0, 0, 0 };
+
+	CHECK(tz_offset(&zone, 0) == 3600);
+	CHECK(zone.from == 0 && zone.until == transitions[0]);
+	CHECK(tz_offset(&zone, transitions[0]) == 7200);
+	CHECK(tz_offset(&zone, transitions[1]) == 3600);
+	CHECK(zone.from == transitions[1] && zone.until == UINT32_MAX);
+	CHECK(tz_offset(&zone, UINT32_MAX) == 3600);
+	CHECK(!tz_is_dst(&zone, CAL_DAYS(99, 12, 31) * 86400UL));
+
+	CHECK(tz_offset(&none, 0) == 3600);
+	CHECK(tz_offset(&none, UINT32_MAX) == 3600);
+}
+
+/**A time within the cached interval is converted without reading the table.
+ *
+ */
+static void test_cache(void)
+{
+	static uint32_t transitions[] = { TZ_EU_YEAR(25) };
+	static struct tz zone = TZ_ZONE(transitions, 0, 60);
+	uint32_t start = transitions[0];
+	uint32_t end = transitions[1];
+
+	CHECK(tz_offset(&zone, start + 1) == 3600);
+	CHECK(zone.from == start && zone.until == end);
+
+	// Changed entries are only seen once a time outside the interval is converted
+	transitions[0] = UINT32_MAX - 1;
+	transitions[1] = UINT32_MAX;
+	CHECK(tz_offset(&zone, end - 1) == 3600);
+	CHECK(tz_offset(&zone, start) == 3600);
+	CHECK(tz_offset(&zone, end) == 0);
+	CHECK(zone.from == 0 && zone.until == UINT32_MAX - 1);
+}
+
+int main(void)
+{
+	test_eu();
+	test_us();
+	test_bounds();
+	test_cache();
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}